@@ -0,0 +1,830 @@
+// curvatureBatch: computes the shader's curvature and ramp colors for OBJ and
+// binary PLY files without Maya, e.g. to bake them on a render farm.
+//
+//   curvatureBatch [--format ply|arrays] [--output DIR] [--scale 5.0] [--jobs N]
+//                  [--memory MB] [--threads N] [--kernel scalar|fast|sse4|avx2]
+//                  [--estimator edge|mean|gaussian] [--precision double|float]
+//                  [--compare] input.obj|input.ply|directory ...
+//
+// Inputs are memory-mapped and parsed in one pass, so only the mesh arrays are
+// held in memory, never the file text. Directories are processed --jobs files
+// at a time, each job serial on one pool thread, and a job only starts while
+// the estimated memory of the running ones stays below --memory. A single file
+// (or --jobs 1) gets the whole pool instead.
+//
+// --format ply writes <name>.curvature.ply: positions, float curvature and
+// uchar RGB per vertex plus the triangulated faces. --format arrays writes raw
+// <name>.curvature.f32 (float per vertex) and <name>.rgb.u8 (3 bytes per vertex),
+// both in the vertex order of the input and in the host's byte order.
+// Normals come from the PLY when it has nx, ny, nz, else they are area weighted
+// face normals, as OBJ vn are per face corner.
+// Directories are scanned for .obj and .ply files but not for .curvature.ply
+// outputs. Inputs that would write the same outputs, like a.obj and a.ply,
+// fail after the first one.
+//
+// --compare writes nothing but measures the trig-free kernels against the
+// acos reference on every one-ring edge of the inputs. It prints CSV to
+// stdout: maximum and RMS deviation, absolute and relative to the reference
+// plus its median magnitude, and the edges only one of them zeroes as
+// perpendicular to the normal.
+
+#include "CurvatureColorMap.h"
+#include "CurvatureCore.h"
+#include "CurvatureFile.h"
+#include "CurvatureThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const size_t kGrain = 16384;
+static const size_t kWriteBuffer = 1 << 20;
+
+// Accepted --kernel and --estimator values, in enum order
+static const char *kKernelNames[] = { "scalar", "sse4", "avx2", "fast" };
+static const char *kEstimatorNames[] = { "edge", "mean", "gaussian" };
+
+struct BatchOptions {
+	bool arrays = false;
+	std::string outputDir;
+	double scale = 5.0;
+	unsigned int jobs = 0;
+	size_t memoryBudget = size_t(4096) << 20;
+	unsigned int threadCount = 0;
+	CurvatureKernel kernel = curvatureBestKernel();
+	CurvatureEstimator estimator = kEstimatorEdge;
+	CurvaturePrecision precision = kPrecisionDouble;
+	bool compare = false;
+};
+
+struct BatchMesh {
+	std::vector <float> positions;
+	std::vector <float> normals;
+	std::vector <unsigned int> indices;
+
+	size_t vertexCount() const { return positions.size() / 3; }
+	size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// Files ////////////////////////////////////////////////////////////////////////////////////////
+static std::string lowerExtension(const std::string &path) {
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (std::string::npos == dot || (std::string::npos != slash && dot < slash))
+		return "";
+	std::string extension = path.substr(dot + 1);
+	for (char &c : extension)
+		c = (char)tolower((unsigned char)c);
+	return extension;
+}
+
+// A --format ply output of an earlier run
+static bool isOutput(const std::string &path) {
+	static const std::string suffix = ".curvature.ply";
+	return suffix.size() <= path.size() && 0 == path.compare(path.size() - suffix.size(), suffix.size(), suffix);
+}
+
+// Output path without the extension, in outputDir when one is given
+static std::string outputStem(const std::string &path, const std::string &outputDir) {
+	size_t slash = path.find_last_of("/\\");
+	size_t dot = path.find_last_of('.');
+	std::string stem = (std::string::npos != dot && (std::string::npos == slash || slash < dot)) ? path.substr(0, dot) : path;
+	if (outputDir.empty())
+		return stem;
+	return outputDir + "/" + stem.substr(std::string::npos == slash ? 0 : slash + 1);
+}
+
+static bool hostLittleEndian() {
+	const uint16_t one = 1;
+	unsigned char first;
+	memcpy(&first, &one, 1);
+	return 1 == first;
+}
+
+// OBJ //////////////////////////////////////////////////////////////////////////////////////////
+// Reads v and f lines, polygons are triangulated as fans. Texture coordinates,
+// normals and everything else are skipped.
+static bool loadObj(const CurvatureMappedFile &file, BatchMesh &mesh, std::string &error) {
+	const char *p = file.data();
+	const char *end = p + file.size();
+
+	// Lines are copied so strtof and strtol stop at the terminator, not the end of the mapping
+	std::string line;
+	std::vector <unsigned int> face;
+	size_t lineNumber = 0;
+
+	while (p < end) {
+		const char *eol = (const char*)memchr(p, '\n', end - p);
+		if (NULL == eol)
+			eol = end;
+		line.assign(p, eol);
+		p = eol < end ? eol + 1 : end;
+		lineNumber++;
+
+		const char *s = line.c_str();
+		while (' ' == *s || '\t' == *s)
+			s++;
+
+		if ('v' == s[0] && (' ' == s[1] || '\t' == s[1])) {
+			s += 2;
+			for (unsigned int axis = 0; axis < 3; axis++) {
+				char *next;
+				float value = strtof(s, &next);
+				if (next == s) {
+					error = "bad vertex on line " + std::to_string(lineNumber);
+					return false;
+				}
+				mesh.positions.push_back(value);
+				s = next;
+			}
+		}
+		else if ('f' == s[0] && (' ' == s[1] || '\t' == s[1])) {
+			s += 2;
+			face.clear();
+			for (;;) {
+				char *next;
+				long long index = strtoll(s, &next, 10);
+				if (next == s)
+					break;
+
+				// Skip the /vt/vn part of the corner
+				s = next;
+				while (*s && ' ' != *s && '\t' != *s && '\r' != *s)
+					s++;
+
+				// Negative indices count back from the last vertex read
+				long long vertex = index < 0 ? (long long)mesh.vertexCount() + index : index - 1;
+				if (vertex < 0 || UINT_MAX <= vertex) {
+					error = "bad face index on line " + std::to_string(lineNumber);
+					return false;
+				}
+				face.push_back((unsigned int)vertex);
+			}
+
+			for (size_t i = 2; i < face.size(); i++)
+				mesh.indices.insert(mesh.indices.end(), { face[0], face[i - 1], face[i] });
+		}
+	}
+
+	return true;
+}
+
+// PLY //////////////////////////////////////////////////////////////////////////////////////////
+enum PlyType { kPlyNone, kPlyInt8, kPlyUint8, kPlyInt16, kPlyUint16, kPlyInt32, kPlyUint32, kPlyFloat32, kPlyFloat64 };
+
+struct PlyProperty {
+	std::string name;
+	PlyType type = kPlyNone;
+	PlyType countType = kPlyNone;	// Set for list properties
+};
+
+struct PlyElement {
+	std::string name;
+	size_t count = 0;
+	std::vector <PlyProperty> properties;
+};
+
+static PlyType plyType(const std::string &name) {
+	if ("char" == name || "int8" == name)
+		return kPlyInt8;
+	if ("uchar" == name || "uint8" == name)
+		return kPlyUint8;
+	if ("short" == name || "int16" == name)
+		return kPlyInt16;
+	if ("ushort" == name || "uint16" == name)
+		return kPlyUint16;
+	if ("int" == name || "int32" == name)
+		return kPlyInt32;
+	if ("uint" == name || "uint32" == name)
+		return kPlyUint32;
+	if ("float" == name || "float32" == name)
+		return kPlyFloat32;
+	if ("double" == name || "float64" == name)
+		return kPlyFloat64;
+	return kPlyNone;
+}
+
+// Bounds checked reads of binary values, byte swapped when the file's order isn't the host's
+class PlyReader {
+public:
+	PlyReader(const char *begin, const char *end, bool swap) : m_p(begin), m_end(end), m_swap(swap) {}
+
+	bool failed() const { return m_failed; }
+
+	double read(PlyType type) {
+		switch (type) {
+		case kPlyInt8: return get <int8_t>();
+		case kPlyUint8: return get <uint8_t>();
+		case kPlyInt16: return get <int16_t>();
+		case kPlyUint16: return get <uint16_t>();
+		case kPlyInt32: return get <int32_t>();
+		case kPlyUint32: return get <uint32_t>();
+		case kPlyFloat32: return get <float>();
+		case kPlyFloat64: return get <double>();
+		default: m_failed = true; return 0;
+		}
+	}
+
+private:
+	template <class T>
+	T get() {
+		if (size_t(m_end - m_p) < sizeof(T)) {
+			m_failed = true;
+			m_p = m_end;
+			return T();
+		}
+
+		unsigned char bytes[sizeof(T)];
+		memcpy(bytes, m_p, sizeof(T));
+		if (m_swap)
+			std::reverse(bytes, bytes + sizeof(T));
+		m_p += sizeof(T);
+
+		T value;
+		memcpy(&value, bytes, sizeof(T));
+		return value;
+	}
+
+	const char *m_p;
+	const char *m_end;
+	bool m_swap;
+	bool m_failed = false;
+};
+
+static bool loadPly(const CurvatureMappedFile &file, BatchMesh &mesh, std::string &error) {
+	const char *p = file.data();
+	const char *end = p + file.size();
+
+	// Header
+	std::vector <PlyElement> elements;
+	std::string format;
+	bool headerDone = false;
+	for (size_t lineNumber = 0; p < end && !headerDone; lineNumber++) {
+		const char *eol = (const char*)memchr(p, '\n', end - p);
+		if (NULL == eol)
+			break;
+		std::string line(p, eol);
+		p = eol + 1;
+		if (!line.empty() && '\r' == line.back())
+			line.pop_back();
+
+		std::istringstream stream(line);
+		std::string keyword;
+		stream >> keyword;
+
+		if (0 == lineNumber && "ply" != keyword)
+			break;
+		else if ("format" == keyword)
+			stream >> format;
+		else if ("element" == keyword) {
+			PlyElement element;
+			stream >> element.name >> element.count;
+			elements.push_back(element);
+		}
+		else if ("property" == keyword && !elements.empty()) {
+			PlyProperty property;
+			std::string type;
+			stream >> type;
+			if ("list" == type) {
+				std::string countType;
+				stream >> countType >> type;
+				property.countType = plyType(countType);
+				if (kPlyNone == property.countType) {
+					error = "unknown PLY type " + countType;
+					return false;
+				}
+			}
+			property.type = plyType(type);
+			stream >> property.name;
+			if (kPlyNone == property.type) {
+				error = "unknown PLY type " + type;
+				return false;
+			}
+			elements.back().properties.push_back(property);
+		}
+		else if ("end_header" == keyword)
+			headerDone = true;
+	}
+
+	if (!headerDone) {
+		error = "not a PLY file";
+		return false;
+	}
+	if ("binary_little_endian" != format && "binary_big_endian" != format) {
+		error = "unsupported PLY format " + format + ", only binary PLY is read";
+		return false;
+	}
+
+	PlyReader reader(p, end, ("binary_little_endian" == format) != hostLittleEndian());
+	std::vector <double> values;
+	std::vector <unsigned int> face;
+
+	for (const PlyElement &element : elements) {
+		bool isVertex = "vertex" == element.name;
+		bool isFace = "face" == element.name;
+
+		// Property slots of x, y, z, nx, ny, nz and of the face indices
+		int slots[6] = { -1, -1, -1, -1, -1, -1 };
+		int indexSlot = -1;
+		const char *names[6] = { "x", "y", "z", "nx", "ny", "nz" };
+		for (size_t i = 0; i < element.properties.size(); i++) {
+			const PlyProperty &property = element.properties[i];
+			for (unsigned int k = 0; k < 6; k++)
+				if (isVertex && kPlyNone == property.countType && names[k] == property.name)
+					slots[k] = (int)i;
+			if (isFace && kPlyNone != property.countType && ("vertex_indices" == property.name || "vertex_index" == property.name))
+				indexSlot = (int)i;
+		}
+
+		if (isVertex && (slots[0] < 0 || slots[1] < 0 || slots[2] < 0)) {
+			error = "PLY vertices have no x, y, z";
+			return false;
+		}
+		bool hasNormals = isVertex && 0 <= slots[3] && 0 <= slots[4] && 0 <= slots[5];
+		if (isVertex) {
+			mesh.positions.reserve(element.count * 3);
+			if (hasNormals)
+				mesh.normals.reserve(element.count * 3);
+		}
+
+		values.resize(element.properties.size());
+		for (size_t item = 0; item < element.count; item++) {
+			for (size_t i = 0; i < element.properties.size(); i++) {
+				const PlyProperty &property = element.properties[i];
+				if (kPlyNone == property.countType) {
+					values[i] = reader.read(property.type);
+					continue;
+				}
+
+				size_t count = (size_t)reader.read(property.countType);
+				if ((int)i != indexSlot) {
+					for (size_t k = 0; k < count && !reader.failed(); k++)
+						reader.read(property.type);
+					continue;
+				}
+
+				face.clear();
+				for (size_t k = 0; k < count && !reader.failed(); k++) {
+					double index = reader.read(property.type);
+					if (index < 0 || UINT_MAX <= index) {
+						error = "bad PLY face index";
+						return false;
+					}
+					face.push_back((unsigned int)index);
+				}
+				for (size_t k = 2; k < face.size(); k++)
+					mesh.indices.insert(mesh.indices.end(), { face[0], face[k - 1], face[k] });
+			}
+
+			if (reader.failed()) {
+				error = "PLY file is truncated";
+				return false;
+			}
+
+			if (isVertex) {
+				for (unsigned int k = 0; k < 3; k++)
+					mesh.positions.push_back(float(values[slots[k]]));
+				if (hasNormals)
+					for (unsigned int k = 3; k < 6; k++)
+						mesh.normals.push_back(float(values[slots[k]]));
+			}
+		}
+	}
+
+	return true;
+}
+
+// Output ///////////////////////////////////////////////////////////////////////////////////////
+// Records are gathered in a fixed buffer and written in large blocks
+class BatchWriter {
+public:
+	explicit BatchWriter(const std::string &path) : m_file(fopen(path.c_str(), "wb")) { m_buffer.reserve(kWriteBuffer); }
+	~BatchWriter() { close(); }
+
+	bool isOpen() const { return NULL != m_file; }
+
+	void write(const void *data, size_t size) {
+		if (kWriteBuffer < m_buffer.size() + size)
+			flush();
+		const char *bytes = (const char*)data;
+		m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+	}
+
+	// False when anything failed to write
+	bool close() {
+		if (NULL == m_file)
+			return m_ok;
+		flush();
+		m_ok = 0 == fclose(m_file) && m_ok;
+		m_file = NULL;
+		return m_ok;
+	}
+
+private:
+	void flush() {
+		if (!m_buffer.empty() && m_buffer.size() != fwrite(m_buffer.data(), 1, m_buffer.size(), m_file))
+			m_ok = false;
+		m_buffer.clear();
+	}
+
+	FILE *m_file;
+	std::vector <char> m_buffer;
+	bool m_ok = true;
+};
+
+// Binary PLY in the host's byte order
+static bool writePly(const std::string &path, const BatchMesh &mesh, const std::vector <float> &curvature, const std::vector <unsigned char> &colors) {
+	BatchWriter writer(path);
+	if (!writer.isOpen())
+		return false;
+
+	std::string header = std::string("ply\nformat ") + (hostLittleEndian() ? "binary_little_endian" : "binary_big_endian") + " 1.0\n"
+		"comment curvatureBatch\n"
+		"element vertex " + std::to_string(mesh.vertexCount()) + "\n"
+		"property float x\nproperty float y\nproperty float z\n"
+		"property float curvature\n"
+		"property uchar red\nproperty uchar green\nproperty uchar blue\n"
+		"element face " + std::to_string(mesh.triangleCount()) + "\n"
+		"property list uchar int vertex_indices\n"
+		"end_header\n";
+	writer.write(header.data(), header.size());
+
+	for (size_t v = 0; v < mesh.vertexCount(); v++) {
+		writer.write(&mesh.positions[v * 3], 3 * sizeof(float));
+		writer.write(&curvature[v], sizeof(float));
+		writer.write(&colors[v * 3], 3);
+	}
+
+	const unsigned char corners = 3;
+	for (size_t t = 0; t < mesh.triangleCount(); t++) {
+		writer.write(&corners, 1);
+		writer.write(&mesh.indices[t * 3], 3 * sizeof(unsigned int));
+	}
+
+	return writer.close();
+}
+
+static bool writeArray(const std::string &path, const void *data, size_t size) {
+	BatchWriter writer(path);
+	if (!writer.isOpen())
+		return false;
+
+	const char *bytes = (const char*)data;
+	for (size_t offset = 0; offset < size; offset += kWriteBuffer)
+		writer.write(bytes + offset, std::min(kWriteBuffer, size - offset));
+	return writer.close();
+}
+
+// Pipeline /////////////////////////////////////////////////////////////////////////////////////
+// The shader's default ramp: blue, green, red
+static void bakeRamp(CurvatureColorMap &colorMap) {
+	const float ramp[3][3] = { { 0, 0, 1 }, { 0, 1, 0 }, { 1, 0, 0 } };
+
+	for (unsigned int i = 0; i < CurvatureColorMap::kSize; i++) {
+		float position = float(i) / (CurvatureColorMap::kSize - 1) * 2;
+		unsigned int key = std::min(1u, (unsigned int)position);
+		float t = position - key;
+		colorMap.set(i,
+			ramp[key][0] + (ramp[key + 1][0] - ramp[key][0]) * t,
+			ramp[key][1] + (ramp[key + 1][1] - ramp[key][1]) * t,
+			ramp[key][2] + (ramp[key + 1][2] - ramp[key][2]) * t);
+	}
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point &start) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration <double, std::milli>(now - start).count();
+	start = now;
+	return ms;
+}
+
+// Edge kernels against the reference ////////////////////////////////////////////////////////////
+static void compareKernels(const std::string &path, const BatchMesh &input, unsigned int threadCount) {
+	static const double identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+	static const CurvatureKernel kernels[] = { kKernelFast, kKernelSse4, kKernelAvx2 };
+
+	// Only for the topology and the cached positions and normals
+	CurvatureMesh mesh;
+	mesh.threadCount = threadCount;
+	mesh.kernel = kKernelScalar;
+	mesh.update((int)input.indices.size(), input.indices.data(), (int)input.vertexCount(),
+		input.positions.data(), NULL, input.normals.data(), identity);
+
+	std::vector <unsigned int> from, to;
+	from.reserve(mesh.topology.rings.size());
+	to.reserve(mesh.topology.rings.size());
+	for (unsigned int v = 0; v < mesh.topology.vertexCount(); v++) {
+		for (unsigned int e = mesh.topology.ringOffsets[v]; e < mesh.topology.ringOffsets[v + 1]; e++) {
+			from.push_back(v);
+			to.push_back(mesh.topology.rings[e]);
+		}
+	}
+
+	CurvatureEdgeStreams streams = mesh.vertices.streams(mesh.normals);
+	auto run = [&](CurvatureKernel kernel, std::vector <double> &values) {
+		CurvatureEdgeFunc edgeFunc = curvatureEdgeFunc(kernel);
+		values.resize(from.size());
+		CurvatureThreadPool::instance().parallelFor(from.size(), kGrain, threadCount, [&](size_t begin, size_t end) {
+			edgeFunc(end - begin, from.data() + begin, to.data() + begin, streams, values.data() + begin);
+		});
+	};
+
+	std::vector <double> reference, values;
+	run(kKernelScalar, reference);
+
+	std::vector <double> magnitudes(reference.size());
+	for (size_t e = 0; e < reference.size(); e++)
+		magnitudes[e] = fabs(reference[e]);
+	std::nth_element(magnitudes.begin(), magnitudes.begin() + magnitudes.size() / 2, magnitudes.end());
+	double median = magnitudes.empty() ? 0 : magnitudes[magnitudes.size() / 2];
+	std::vector <double>().swap(magnitudes);
+
+	for (CurvatureKernel kernel : kernels) {
+		if (!curvatureKernelSupported(kernel))
+			continue;
+		run(kernel, values);
+
+		double maxAbsolute = 0, absoluteSq = 0, maxRelative = 0, relativeSq = 0;
+		size_t zeroMismatches = 0;
+		for (size_t e = 0; e < reference.size(); e++) {
+			// Diverging edges along the normal are infinite in both
+			if (reference[e] == values[e])
+				continue;
+			zeroMismatches += (0 == reference[e]) != (0 == values[e]);
+
+			double absolute = fabs(values[e] - reference[e]);
+			double scale = fabs(reference[e]) + median;
+			double relative = 0 < scale ? absolute / scale : absolute;
+			if (!(absolute <= maxAbsolute))
+				maxAbsolute = absolute;
+			if (!(relative <= maxRelative))
+				maxRelative = relative;
+			absoluteSq += absolute * absolute;
+			relativeSq += relative * relative;
+		}
+
+		double count = double(std::max<size_t>(1, reference.size()));
+		printf("%s,%zu,%s,%.3g,%.3g,%.3g,%.3g,%zu\n", path.c_str(), reference.size(), curvatureKernelName(kernel),
+			maxAbsolute, sqrt(absoluteSq / count), maxRelative, sqrt(relativeSq / count), zeroMismatches);
+	}
+}
+
+static bool processFile(const std::string &path, const BatchOptions &options, const CurvatureColorMap &colorMap, unsigned int threadCount) {
+	static const double identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	BatchMesh input;
+	std::string error;
+	{
+		CurvatureMappedFile file;
+		if (!file.open(path, true))
+			error = "can't read the file";
+		else if ("obj" == lowerExtension(path))
+			loadObj(file, input, error);
+		else
+			loadPly(file, input, error);
+	}
+
+	if (error.empty() && (INT_MAX < input.indices.size() || INT_MAX < input.vertexCount()))
+		error = "mesh is too large";
+	if (error.empty()) {
+		for (unsigned int index : input.indices) {
+			if (input.vertexCount() <= index) {
+				error = "face index out of range";
+				break;
+			}
+		}
+	}
+	if (!error.empty()) {
+		fprintf(stderr, "%s: %s\n", path.c_str(), error.c_str());
+		return false;
+	}
+
+	if (input.normals.size() != input.positions.size()) {
+		input.normals.resize(input.positions.size());
+		curvatureVertexNormals(input.indices.size(), input.indices.data(), input.vertexCount(), input.positions.data(), input.normals.data());
+	}
+	double readMs = elapsedMs(start);
+
+	if (options.compare) {
+		compareKernels(path, input, threadCount);
+		return true;
+	}
+
+	// One draw vertex per file vertex, so unique vertices follow the file order
+	CurvatureMesh mesh;
+	mesh.threadCount = threadCount;
+	mesh.kernel = options.kernel;
+	mesh.estimator = options.estimator;
+	mesh.precision = options.precision;
+	mesh.update((int)input.indices.size(), input.indices.data(), (int)input.vertexCount(),
+		input.positions.data(), NULL, input.normals.data(), identity);
+
+	// Normals aren't written
+	std::vector <float>().swap(input.normals);
+
+	size_t vertexCount = input.vertexCount();
+	std::vector <float> curvature(vertexCount);
+	std::vector <unsigned char> colors(vertexCount * 3);
+	CurvatureThreadPool::instance().parallelFor(vertexCount, kGrain, threadCount, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			double value = mesh.curvatureAt(mesh.topology.unique((unsigned int)v));
+			float rgb[3];
+			colorMap.lookup(value, options.scale, rgb);
+
+			curvature[v] = float(value);
+			for (unsigned int k = 0; k < 3; k++)
+				colors[v * 3 + k] = CurvatureColorMap::toByte(rgb[k]);
+		}
+	});
+	mesh = CurvatureMesh();
+	double curvatureMs = elapsedMs(start);
+
+	std::string stem = outputStem(path, options.outputDir);
+	bool written;
+	if (options.arrays)
+		written = writeArray(stem + ".curvature.f32", curvature.data(), curvature.size() * sizeof(float)) &&
+			writeArray(stem + ".rgb.u8", colors.data(), colors.size());
+	else
+		written = writePly(stem + ".curvature.ply", input, curvature, colors);
+	double writeMs = elapsedMs(start);
+
+	if (!written) {
+		fprintf(stderr, "%s: can't write %s.*\n", path.c_str(), stem.c_str());
+		return false;
+	}
+
+	fprintf(stderr, "%s: %zu vertices, %zu triangles, read %.1f ms, curvature %.1f ms, write %.1f ms\n",
+		path.c_str(), vertexCount, input.triangleCount(), readMs, curvatureMs, writeMs);
+	return true;
+}
+
+// Main /////////////////////////////////////////////////////////////////////////////////////////
+// Peak memory of a job relative to its file size, measured on 4M vertex grids.
+// CurvatureMesh takes about 250 bytes per vertex, text OBJ about 60 and
+// binary PLY about 40.
+static size_t estimateBytes(const std::string &path) {
+	CurvatureMappedFile file;
+	if (!file.open(path))
+		return 0;
+	return "obj" == lowerExtension(path) ? file.size() * 4 : file.size() * 6;
+}
+
+// Index of value among names, or -1 after listing the accepted ones
+template <size_t Count>
+static int parseName(const char *flag, const char *value, const char *(&names)[Count]) {
+	for (size_t i = 0; i < Count; i++)
+		if (!strcmp(value, names[i]))
+			return int(i);
+
+	fprintf(stderr, "unknown %s %s, expected", flag, value);
+	for (size_t i = 0; i < Count; i++)
+		fprintf(stderr, "%s %s", i ? "," : "", names[i]);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+int main(int argc, char **argv) {
+	BatchOptions options;
+	std::vector <std::string> inputs;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if ('-' != arg[0]) {
+			inputs.push_back(arg);
+			continue;
+		}
+
+		if ("--format" == arg && value && (!strcmp(value, "ply") || !strcmp(value, "arrays")))
+			options.arrays = !strcmp(value, "arrays");
+		else if ("--output" == arg && value)
+			options.outputDir = value;
+		else if ("--scale" == arg && value)
+			options.scale = atof(value);
+		else if ("--jobs" == arg && value)
+			options.jobs = (unsigned int)std::max(1, atoi(value));
+		else if ("--memory" == arg && value)
+			options.memoryBudget = size_t(std::max(1, atoi(value))) << 20;
+		else if ("--threads" == arg && value)
+			options.threadCount = (unsigned int)std::max(0, atoi(value));
+		else if ("--kernel" == arg && value) {
+			int kernel = parseName(arg.c_str(), value, kKernelNames);
+			if (kernel < 0)
+				return 2;
+			options.kernel = CurvatureKernel(kernel);
+		}
+		else if ("--estimator" == arg && value) {
+			int estimator = parseName(arg.c_str(), value, kEstimatorNames);
+			if (estimator < 0)
+				return 2;
+			options.estimator = CurvatureEstimator(estimator);
+		}
+		else if ("--precision" == arg && value && (!strcmp(value, "double") || !strcmp(value, "float")))
+			options.precision = !strcmp(value, "float") ? kPrecisionFloat : kPrecisionDouble;
+		else if ("--compare" == arg) {
+			options.compare = true;
+			continue;
+		}
+		else {
+			inputs.clear();
+			break;
+		}
+		i++;
+	}
+
+	if (inputs.empty()) {
+		fprintf(stderr, "usage: %s [--format ply|arrays] [--output DIR] [--scale 5.0] [--jobs N] [--memory MB]\n"
+			"       [--threads N] [--kernel scalar|fast|sse4|avx2] [--estimator edge|mean|gaussian]\n"
+			"       [--precision double|float] [--compare] input.obj|input.ply|directory ...\n", argv[0]);
+		return 2;
+	}
+
+	std::vector <std::string> files;
+	for (const std::string &input : inputs) {
+		if (!curvatureIsDirectory(input)) {
+			files.push_back(input);
+			continue;
+		}
+
+		std::vector <CurvatureFileInfo> listed;
+		curvatureListDirectory(input, listed);
+		std::sort(listed.begin(), listed.end(), [](const CurvatureFileInfo &a, const CurvatureFileInfo &b) { return a.path < b.path; });
+		for (const CurvatureFileInfo &file : listed)
+			if ("obj" == lowerExtension(file.path) || ("ply" == lowerExtension(file.path) && !isOutput(file.path)))
+				files.push_back(file.path);
+	}
+
+	size_t fileCount = files.size();
+	unsigned int failures = 0;
+
+	// The first of the inputs sharing an output stem is processed
+	if (!options.compare) {
+		std::map <std::string, std::string> stems;
+		std::vector <std::string> distinct;
+		for (const std::string &file : files) {
+			auto inserted = stems.emplace(outputStem(file, options.outputDir), file);
+			if (inserted.second)
+				distinct.push_back(file);
+			else {
+				fprintf(stderr, "%s: skipped, it would overwrite the outputs of %s\n", file.c_str(), inserted.first->second.c_str());
+				failures++;
+			}
+		}
+		files.swap(distinct);
+	}
+
+	CurvatureColorMap colorMap;
+	bakeRamp(colorMap);
+
+	CurvatureThreadPool &pool = CurvatureThreadPool::instance();
+	unsigned int jobs = options.jobs ? options.jobs : pool.size();
+	jobs = (unsigned int)std::min<size_t>(jobs, files.size());
+
+	// Several jobs run serially on pool threads, a single one gets the pool
+	unsigned int threadCount = 1 < jobs ? 1 : options.threadCount;
+
+	std::mutex mutex;
+	std::condition_variable released;
+	size_t reserved = 0;
+
+	if (options.compare)
+		printf("file,edges,kernel,max,rms,maxRelative,rmsRelative,zeroMismatches\n");
+
+	pool.parallelFor(files.size(), 1, jobs, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			// A job larger than the budget still runs, but alone
+			size_t bytes = std::min(estimateBytes(files[i]), options.memoryBudget);
+			{
+				std::unique_lock <std::mutex> lock(mutex);
+				released.wait(lock, [&]() { return reserved + bytes <= options.memoryBudget; });
+				reserved += bytes;
+			}
+
+			bool succeeded = processFile(files[i], options, colorMap, threadCount);
+
+			{
+				std::lock_guard <std::mutex> lock(mutex);
+				reserved -= bytes;
+				failures += !succeeded;
+			}
+			released.notify_all();
+		}
+	});
+
+	if (0 < failures)
+		fprintf(stderr, "%u of %zu files failed\n", failures, fileCount);
+	return 0 < failures ? 1 : 0;
+}
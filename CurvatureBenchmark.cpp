@@ -0,0 +1,581 @@
+// curvatureBenchmark: times the curvature and color pipeline of the shader
+// (updateCurvature -> updateColors -> getColors) on generated meshes, without
+// Maya. Results are written as CSV and can be compared against a baseline.
+//
+//   curvatureBenchmark [--sizes 10000,100000,...] [--meshes sphere,torus,terrain,grid]
+//                      [--repeat N] [--threads N] [--kernel scalar|fast|sse4|avx2]
+//                      [--estimator edge|mean|gaussian] [--precision double|float]
+//                      [--output results.csv] [--baseline baseline.csv] [--tolerance 0.1]
+//                      [--accuracy]
+//
+// Exits with 1 when a scenario is slower than the baseline by more than the
+// tolerance and by at least kNoiseFloorMs, so it can gate a plugin build.
+//
+// --accuracy skips the timings and compares every kernel, precision and
+// estimator specialization against the scalar double one of its estimator.
+// It writes the maximum and RMS deviation as CSV, each relative to the
+// reference plus its median magnitude so neither flat areas nor degenerate
+// spikes dominate, and exits with 1 when an RMS deviation exceeds
+// kDoubleLimit or kFloatLimit, or when a specialization run serially doesn't
+// match it run on the threads bit for bit.
+
+#include "CurvatureColorMap.h"
+#include "CurvatureCore.h"
+#include "CurvatureThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const double kPi = 3.14159265358979323846;
+static const double kDoubleLimit = 1e-6;
+static const double kFloatLimit = 1e-3;
+// Slowdowns below this are timer and scheduling noise, whatever the ratio
+static const double kNoiseFloorMs = 0.5;
+
+static const char *kEstimatorNames[] = { "edge", "mean", "gaussian" };
+static const char *kPrecisionNames[] = { "double", "float" };
+
+// Draw buffers as VP2 hands them to the shader, one draw vertex per vertex
+struct BenchMesh {
+	std::vector <float> positions;
+	std::vector <float> normals;
+	std::vector <unsigned int> indices;
+
+	unsigned int vertexCount() const { return (unsigned int)(positions.size() / 3); }
+	size_t triangleCount() const { return indices.size() / 3; }
+};
+
+struct BenchResult {
+	std::string mesh;
+	size_t triangles;
+	unsigned int vertices;
+	std::string scenario;
+	double ms;
+};
+
+// Mesh generators //////////////////////////////////////////////////////////////////////////////
+// Two triangles per cell of a nu x nv grid of vertex rows, wrapped in u and/or v
+static void gridIndices(BenchMesh &mesh, unsigned int nu, unsigned int nv, bool wrapU, bool wrapV) {
+	unsigned int rowSize = wrapU ? nu : nu + 1;
+	unsigned int rows = wrapV ? nv : nv + 1;
+
+	mesh.indices.clear();
+	mesh.indices.reserve(size_t(nu) * nv * 6);
+	for (unsigned int j = 0; j < nv; j++) {
+		for (unsigned int i = 0; i < nu; i++) {
+			unsigned int a = j * rowSize + i;
+			unsigned int b = j * rowSize + (wrapU ? (i + 1) % nu : i + 1);
+			unsigned int c = ((j + 1) % rows) * rowSize + i;
+			unsigned int d = ((j + 1) % rows) * rowSize + (wrapU ? (i + 1) % nu : i + 1);
+			mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+		}
+	}
+}
+
+// Area weighted face normals accumulated per vertex
+static void computeNormals(BenchMesh &mesh) {
+	mesh.normals.resize(mesh.positions.size());
+	curvatureVertexNormals(mesh.indices.size(), mesh.indices.data(), mesh.vertexCount(), mesh.positions.data(), mesh.normals.data());
+}
+
+static void makeSphere(BenchMesh &mesh, size_t triangles) {
+	unsigned int nv = std::max(2u, (unsigned int)sqrt(triangles / 4.0));
+	unsigned int nu = std::max(3u, (unsigned int)(triangles / (2.0 * nv)));
+
+	mesh.positions.clear();
+	for (unsigned int j = 0; j <= nv; j++) {
+		double theta = kPi * j / nv;
+		for (unsigned int i = 0; i < nu; i++) {
+			double phi = 2 * kPi * i / nu;
+			mesh.positions.insert(mesh.positions.end(), {
+				float(sin(theta) * cos(phi)), float(sin(theta) * sin(phi)), float(cos(theta)) });
+		}
+	}
+	gridIndices(mesh, nu, nv, true, false);
+	computeNormals(mesh);
+}
+
+static void makeTorus(BenchMesh &mesh, size_t triangles) {
+	unsigned int nv = std::max(3u, (unsigned int)sqrt(triangles / 6.0));
+	unsigned int nu = std::max(3u, (unsigned int)(triangles / (2.0 * nv)));
+	const double major = 1.0, minor = 0.35;
+
+	mesh.positions.clear();
+	for (unsigned int j = 0; j < nv; j++) {
+		double theta = 2 * kPi * j / nv;
+		for (unsigned int i = 0; i < nu; i++) {
+			double phi = 2 * kPi * i / nu;
+			double ring = major + minor * cos(theta);
+			mesh.positions.insert(mesh.positions.end(), {
+				float(ring * cos(phi)), float(ring * sin(phi)), float(minor * sin(theta)) });
+		}
+	}
+	gridIndices(mesh, nu, nv, true, true);
+	computeNormals(mesh);
+}
+
+// Smoothly interpolated lattice noise, summed over octaves
+static double latticeNoise(int x, int y, unsigned int seed) {
+	uint32_t h = uint32_t(x) * 374761393u + uint32_t(y) * 668265263u + seed * 2246822519u;
+	h = (h ^ (h >> 13)) * 1274126177u;
+	return (h ^ (h >> 16)) / 4294967295.0 * 2 - 1;
+}
+
+static double valueNoise(double x, double y, unsigned int seed) {
+	int ix = (int)floor(x), iy = (int)floor(y);
+	double fx = x - ix, fy = y - iy;
+	fx = fx * fx * (3 - 2 * fx);
+	fy = fy * fy * (3 - 2 * fy);
+
+	double a = latticeNoise(ix, iy, seed), b = latticeNoise(ix + 1, iy, seed);
+	double c = latticeNoise(ix, iy + 1, seed), d = latticeNoise(ix + 1, iy + 1, seed);
+	return (a + (b - a) * fx) + ((c + (d - c) * fx) - (a + (b - a) * fx)) * fy;
+}
+
+static void makeTerrain(BenchMesh &mesh, size_t triangles) {
+	unsigned int n = std::max(1u, (unsigned int)sqrt(triangles / 2.0));
+
+	mesh.positions.clear();
+	for (unsigned int j = 0; j <= n; j++) {
+		for (unsigned int i = 0; i <= n; i++) {
+			double x = double(i) / n, y = double(j) / n;
+			double height = 0, amplitude = 0.2, frequency = 4;
+			for (unsigned int octave = 0; octave < 6; octave++) {
+				height += amplitude * valueNoise(x * frequency, y * frequency, octave);
+				amplitude *= 0.5;
+				frequency *= 2;
+			}
+			mesh.positions.insert(mesh.positions.end(), { float(x), float(y), float(height) });
+		}
+	}
+	gridIndices(mesh, n, n, false, false);
+	computeNormals(mesh);
+}
+
+static void makeGrid(BenchMesh &mesh, size_t triangles) {
+	unsigned int n = std::max(1u, (unsigned int)sqrt(triangles / 2.0));
+	std::mt19937 random(1234);
+	std::uniform_real_distribution <float> jitter(-0.3f, 0.3f);
+
+	mesh.positions.clear();
+	for (unsigned int j = 0; j <= n; j++)
+		for (unsigned int i = 0; i <= n; i++)
+			mesh.positions.insert(mesh.positions.end(), {
+				(i + jitter(random)) / n, (j + jitter(random)) / n, jitter(random) / n });
+	gridIndices(mesh, n, n, false, false);
+	computeNormals(mesh);
+}
+
+static bool makeMesh(const std::string &name, size_t triangles, BenchMesh &mesh) {
+	if ("sphere" == name)
+		makeSphere(mesh, triangles);
+	else if ("torus" == name)
+		makeTorus(mesh, triangles);
+	else if ("terrain" == name)
+		makeTerrain(mesh, triangles);
+	else if ("grid" == name)
+		makeGrid(mesh, triangles);
+	else
+		return false;
+	return true;
+}
+
+// Pipeline //////////////////////////////////////////////////////////////////////////////////////
+static void bakeRamp(CurvatureColorMap &colorMap, bool alternate) {
+	// The shader's default blue, green, red ramp, or red, white, blue
+	const float rampA[3][3] = { { 0, 0, 1 }, { 0, 1, 0 }, { 1, 0, 0 } };
+	const float rampB[3][3] = { { 1, 0, 0 }, { 1, 1, 1 }, { 0, 0, 1 } };
+	const float (*ramp)[3] = alternate ? rampB : rampA;
+
+	for (unsigned int i = 0; i < CurvatureColorMap::kSize; i++) {
+		float position = float(i) / (CurvatureColorMap::kSize - 1) * 2;
+		unsigned int key = std::min(1u, (unsigned int)position);
+		float t = position - key;
+		colorMap.set(i,
+			ramp[key][0] + (ramp[key + 1][0] - ramp[key][0]) * t,
+			ramp[key][1] + (ramp[key + 1][1] - ramp[key][1]) * t,
+			ramp[key][2] + (ramp[key + 1][2] - ramp[key][2]) * t);
+	}
+}
+
+struct Pipeline {
+	CurvatureMesh mesh;
+	CurvatureColorMap colorMap;
+	std::vector <float> colors;
+	std::vector <float> colorBuffer;	// Stands in for the acquired VP2 buffer
+	unsigned int threadCount = 0;
+	double scale = 5.0;
+
+	// updateCurvature, updateColors and getColors of the shader
+	void draw(const BenchMesh &input, bool recolorAll) {
+		static const double identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+
+		mesh.threadCount = threadCount;
+		mesh.update((int)input.indices.size(), input.indices.data(), (int)input.vertexCount(),
+			input.positions.data(), NULL, input.normals.data(), identity);
+
+		size_t size = mesh.topology.drawCount() * 3;
+		if (recolorAll || colors.size() != size) {
+			colors.resize(size);
+			colorMap.apply(mesh, scale, colors.data(), threadCount);
+		}
+		else
+			colorMap.applyChanged(mesh, 0, mesh.changed.size(), scale, colors.data(), threadCount);
+
+		colorBuffer.resize(size);
+		memcpy(colorBuffer.data(), colors.data(), size * sizeof(float));
+
+		mesh.releaseChanged();
+	}
+};
+
+template <class Fn>
+static double timeMs(unsigned int repeat, const Fn &fn) {
+	std::vector <double> times;
+	for (unsigned int r = 0; r < repeat; r++) {
+		auto start = std::chrono::steady_clock::now();
+		fn(r);
+		times.push_back(std::chrono::duration <double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	// Median, robust against the odd scheduling hiccup
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+static void runScenarios(const std::string &name, const BenchMesh &input, unsigned int repeat, unsigned int threadCount,
+	CurvatureKernel kernel, CurvatureEstimator estimator, CurvaturePrecision precision, std::vector <BenchResult> &results) {
+	auto record = [&](const char *scenario, double ms) {
+		BenchResult result = { name, input.triangleCount(), input.vertexCount(), scenario, ms };
+		results.push_back(result);
+		fprintf(stderr, "%-8s %10zu tris  %-8s %10.3f ms\n", name.c_str(), result.triangles, scenario, ms);
+	};
+
+	// Cold: first draw of the shape, topology and everything else built from scratch
+	record("cold", timeMs(repeat, [&](unsigned int) {
+		Pipeline pipeline;
+		pipeline.threadCount = threadCount;
+		pipeline.mesh.kernel = kernel;
+		pipeline.mesh.estimator = estimator;
+		pipeline.mesh.precision = precision;
+		bakeRamp(pipeline.colorMap, false);
+		pipeline.draw(input, true);
+	}));
+
+	Pipeline pipeline;
+	pipeline.threadCount = threadCount;
+	pipeline.mesh.kernel = kernel;
+	pipeline.mesh.estimator = estimator;
+	pipeline.mesh.precision = precision;
+	bakeRamp(pipeline.colorMap, false);
+	pipeline.draw(input, true);
+
+	// Kept per shape between draws, like the bytes of curvatureShaderStats
+	size_t bytes = pipeline.mesh.byteSize() + pipeline.colors.capacity() * sizeof(float);
+	fprintf(stderr, "%-8s %10zu tris  %-8s %10.1f bytes/vertex\n", name.c_str(), input.triangleCount(), "memory", double(bytes) / input.vertexCount());
+
+	// Unchanged: a redraw with byte identical buffers
+	record("unchanged", timeMs(repeat, [&](unsigned int) {
+		pipeline.draw(input, false);
+	}));
+
+	// Partial: 1% of the vertices, one contiguous patch, pushed along their normals
+	BenchMesh deformed = input;
+	size_t patch = std::max<size_t>(1, input.vertexCount() / 100);
+	size_t patchBegin = (input.vertexCount() - patch) / 2;
+	record("partial", timeMs(repeat, [&](unsigned int r) {
+		float offset = 0.001f * (r + 1);
+		for (size_t v = patchBegin; v < patchBegin + patch; v++)
+			for (unsigned int axis = 0; axis < 3; axis++)
+				deformed.positions[v * 3 + axis] = input.positions[v * 3 + axis] + input.normals[v * 3 + axis] * offset;
+		pipeline.draw(deformed, false);
+	}));
+
+	// Ramp change: rebake the table and recolor everything, curvature untouched
+	record("ramp", timeMs(repeat, [&](unsigned int r) {
+		bakeRamp(pipeline.colorMap, 0 == r % 2);
+		pipeline.draw(deformed, true);
+	}));
+}
+
+// Accuracy /////////////////////////////////////////////////////////////////////////////////////
+static void computeCurvature(const BenchMesh &input, unsigned int threadCount, CurvatureKernel kernel,
+	CurvatureEstimator estimator, CurvaturePrecision precision, std::vector <double> &curvature) {
+	static const double identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+
+	CurvatureMesh mesh;
+	mesh.threadCount = threadCount;
+	mesh.kernel = kernel;
+	mesh.estimator = estimator;
+	mesh.precision = precision;
+	mesh.update((int)input.indices.size(), input.indices.data(), (int)input.vertexCount(),
+		input.positions.data(), NULL, input.normals.data(), identity);
+	curvature.resize(mesh.topology.vertexCount());
+	for (unsigned int v = 0; v < mesh.topology.vertexCount(); v++)
+		curvature[v] = mesh.curvatureAt(v);
+}
+
+// Threads split the vertices, which must not change a single result
+static bool matchesSerial(const BenchMesh &input, CurvatureKernel kernel, CurvatureEstimator estimator,
+	CurvaturePrecision precision, const std::vector <double> &curvature) {
+	std::vector <double> serial;
+	computeCurvature(input, 1, kernel, estimator, precision, serial);
+	return serial.size() == curvature.size() && 0 == memcmp(serial.data(), curvature.data(), serial.size() * sizeof(double));
+}
+
+// Writes one CSV line per specialization, returns the number over the limits
+// or differing from their serial run
+static unsigned int checkAccuracy(FILE *file, const std::string &name, const BenchMesh &input, unsigned int threadCount) {
+	unsigned int failures = 0;
+	std::vector <double> reference, curvature;
+
+	for (int e = kEstimatorEdge; e <= kEstimatorGaussian; e++) {
+		CurvatureEstimator estimator = CurvatureEstimator(e);
+		computeCurvature(input, threadCount, kKernelScalar, estimator, kPrecisionDouble, reference);
+
+		std::vector <double> magnitudes(reference.size());
+		for (size_t v = 0; v < reference.size(); v++)
+			magnitudes[v] = fabs(reference[v]);
+		std::nth_element(magnitudes.begin(), magnitudes.begin() + magnitudes.size() / 2, magnitudes.end());
+		double median = magnitudes.empty() ? 0 : magnitudes[magnitudes.size() / 2];
+
+		for (int p = kPrecisionDouble; p <= kPrecisionFloat; p++) {
+			for (int k = kKernelScalar; k <= kKernelFast; k++) {
+				// The operators don't use the edge kernels
+				if (!curvatureKernelSupported(CurvatureKernel(k)) || (kEstimatorEdge != estimator && kKernelScalar != k))
+					continue;
+
+				CurvaturePrecision precision = CurvaturePrecision(p);
+				computeCurvature(input, threadCount, CurvatureKernel(k), estimator, precision, curvature);
+				bool serial = matchesSerial(input, CurvatureKernel(k), estimator, precision, curvature);
+
+				double maxDeviation = 0, deviationSq = 0;
+				for (size_t v = 0; v < reference.size(); v++) {
+					double scale = fabs(reference[v]) + median;
+					double deviation = 0 < scale ? fabs(curvature[v] - reference[v]) / scale : fabs(curvature[v] - reference[v]);
+					if (!(deviation <= maxDeviation))
+						maxDeviation = deviation;
+					deviationSq += deviation * deviation;
+				}
+				double rmsDeviation = sqrt(deviationSq / std::max<size_t>(1, reference.size()));
+
+				// NaN deviations fail
+				double limit = kPrecisionFloat == precision ? kFloatLimit : kDoubleLimit;
+				bool failed = !(rmsDeviation <= limit) || !serial;
+				failures += failed;
+
+				fprintf(file, "%s,%zu,%s,%s,%s,%.3g,%.3g,%s%s\n", name.c_str(), input.triangleCount(), kEstimatorNames[e],
+					kPrecisionNames[p], curvatureKernelName(CurvatureKernel(k)), maxDeviation, rmsDeviation,
+					serial ? "same" : "differs", failed ? ",FAIL" : "");
+			}
+		}
+	}
+
+	return failures;
+}
+
+// Baseline /////////////////////////////////////////////////////////////////////////////////////
+static std::string resultKey(const std::string &mesh, size_t triangles, const std::string &scenario) {
+	return mesh + "," + std::to_string(triangles) + "," + scenario;
+}
+
+static void writeResults(FILE *file, const std::vector <BenchResult> &results) {
+	fprintf(file, "mesh,triangles,vertices,scenario,ms\n");
+	for (const BenchResult &result : results)
+		fprintf(file, "%s,%zu,%u,%s,%.4f\n", result.mesh.c_str(), result.triangles, result.vertices, result.scenario.c_str(), result.ms);
+}
+
+static bool readBaseline(const char *path, std::map <std::string, double> &baseline) {
+	std::ifstream file(path);
+	if (!file)
+		return false;
+
+	std::string line;
+	std::getline(file, line);
+	while (std::getline(file, line)) {
+		std::vector <std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while (std::getline(stream, field, ','))
+			fields.push_back(field);
+		if (5 != fields.size())
+			continue;
+		baseline[resultKey(fields[0], std::strtoull(fields[1].c_str(), NULL, 10), fields[3])] = atof(fields[4].c_str());
+	}
+	return true;
+}
+
+// Compares against the baseline, returns the number of regressions
+static unsigned int compareBaseline(const std::vector <BenchResult> &results, const std::map <std::string, double> &baseline, double tolerance) {
+	unsigned int regressions = 0;
+
+	fprintf(stderr, "\n%-8s %10s %-9s %10s %10s %8s\n", "mesh", "triangles", "scenario", "baseline", "current", "ratio");
+	for (const BenchResult &result : results) {
+		auto found = baseline.find(resultKey(result.mesh, result.triangles, result.scenario));
+		if (found == baseline.end() || !(0 < found->second))
+			continue;
+
+		double ratio = result.ms / found->second;
+		bool regressed = 1 + tolerance < ratio && kNoiseFloorMs <= result.ms - found->second;
+		regressions += regressed;
+
+		fprintf(stderr, "%-8s %10zu %-9s %10.3f %10.3f %7.2fx%s\n", result.mesh.c_str(), result.triangles, result.scenario.c_str(),
+			found->second, result.ms, ratio, regressed ? "  REGRESSION" : "");
+	}
+
+	return regressions;
+}
+
+// Main /////////////////////////////////////////////////////////////////////////////////////////
+static std::vector <std::string> split(const char *list) {
+	std::vector <std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+		if (!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+int main(int argc, char **argv) {
+	std::vector <std::string> meshes = { "sphere", "torus", "terrain", "grid" };
+	std::vector <size_t> sizes = { 10000, 100000, 1000000, 5000000, 20000000 };
+	unsigned int repeat = 5;
+	unsigned int threadCount = 0;
+	CurvatureKernel kernel = curvatureBestKernel();
+	CurvatureEstimator estimator = kEstimatorEdge;
+	CurvaturePrecision precision = kPrecisionDouble;
+	bool accuracy = false;
+	const char *outputPath = NULL;
+	const char *baselinePath = NULL;
+	double tolerance = 0.1;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if ("--sizes" == arg && value) {
+			sizes.clear();
+			for (const std::string &size : split(value))
+				sizes.push_back(std::strtoull(size.c_str(), NULL, 10));
+		}
+		else if ("--meshes" == arg && value)
+			meshes = split(value);
+		else if ("--repeat" == arg && value)
+			repeat = std::max(1, atoi(value));
+		else if ("--threads" == arg && value)
+			threadCount = (unsigned int)std::max(0, atoi(value));
+		else if ("--kernel" == arg && value) {
+			if (!strcmp(value, "scalar"))
+				kernel = kKernelScalar;
+			else if (!strcmp(value, "sse4"))
+				kernel = kKernelSse4;
+			else if (!strcmp(value, "avx2"))
+				kernel = kKernelAvx2;
+			else if (!strcmp(value, "fast"))
+				kernel = kKernelFast;
+		}
+		else if ("--estimator" == arg && value) {
+			if (!strcmp(value, "edge"))
+				estimator = kEstimatorEdge;
+			else if (!strcmp(value, "mean"))
+				estimator = kEstimatorMean;
+			else if (!strcmp(value, "gaussian"))
+				estimator = kEstimatorGaussian;
+		}
+		else if ("--precision" == arg && value && (!strcmp(value, "double") || !strcmp(value, "float")))
+			precision = !strcmp(value, "float") ? kPrecisionFloat : kPrecisionDouble;
+		else if ("--accuracy" == arg) {
+			accuracy = true;
+			continue;
+		}
+		else if ("--output" == arg && value)
+			outputPath = value;
+		else if ("--baseline" == arg && value)
+			baselinePath = value;
+		else if ("--tolerance" == arg && value)
+			tolerance = atof(value);
+		else {
+			fprintf(stderr, "usage: %s [--sizes N,...] [--meshes sphere,torus,terrain,grid] [--repeat N] [--threads N]\n"
+				"       [--kernel scalar|fast|sse4|avx2] [--estimator edge|mean|gaussian] [--precision double|float]\n"
+				"       [--output file.csv] [--baseline file.csv] [--tolerance 0.1] [--accuracy]\n", argv[0]);
+			return 2;
+		}
+		i++;
+	}
+
+	fprintf(stderr, "kernel %s, %u threads\n", curvatureKernelName(kernel),
+		threadCount ? std::min(threadCount, CurvatureThreadPool::instance().size()) : CurvatureThreadPool::instance().size());
+
+	if (accuracy) {
+		FILE *file = outputPath ? fopen(outputPath, "w") : stdout;
+		if (!file) {
+			fprintf(stderr, "can't write %s\n", outputPath);
+			return 2;
+		}
+
+		unsigned int failures = 0;
+		fprintf(file, "mesh,triangles,estimator,precision,kernel,max,rms,serial\n");
+		for (const std::string &name : meshes) {
+			for (size_t triangles : sizes) {
+				BenchMesh mesh;
+				if (!makeMesh(name, triangles, mesh)) {
+					fprintf(stderr, "unknown mesh %s\n", name.c_str());
+					return 2;
+				}
+				failures += checkAccuracy(file, name, mesh, threadCount);
+			}
+		}
+
+		if (outputPath)
+			fclose(file);
+		return failures ? 1 : 0;
+	}
+
+	std::vector <BenchResult> results;
+	for (const std::string &name : meshes) {
+		for (size_t triangles : sizes) {
+			BenchMesh mesh;
+			if (!makeMesh(name, triangles, mesh)) {
+				fprintf(stderr, "unknown mesh %s\n", name.c_str());
+				return 2;
+			}
+			runScenarios(name, mesh, repeat, threadCount, kernel, estimator, precision, results);
+		}
+	}
+
+	if (outputPath) {
+		FILE *file = fopen(outputPath, "w");
+		if (!file) {
+			fprintf(stderr, "can't write %s\n", outputPath);
+			return 2;
+		}
+		writeResults(file, results);
+		fclose(file);
+	}
+	else
+		writeResults(stdout, results);
+
+	if (baselinePath) {
+		std::map <std::string, double> baseline;
+		if (!readBaseline(baselinePath, baseline)) {
+			fprintf(stderr, "can't read %s\n", baselinePath);
+			return 2;
+		}
+		if (0 < compareBaseline(results, baseline, tolerance))
+			return 1;
+	}
+
+	return 0;
+}
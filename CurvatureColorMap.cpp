@@ -0,0 +1,103 @@
+#include "CurvatureColorMap.h"
+#include "CurvatureCore.h"
+#include "CurvatureThreadPool.h"
+
+static const size_t kGrain = 4096;
+
+void CurvatureColorMap::set(unsigned int i, float r, float g, float b) {
+	if (table.size() != kSize * 3)
+		table.assign(kSize * 3, 0.0f);
+
+	table[i * 3 + 0] = r;
+	table[i * 3 + 1] = g;
+	table[i * 3 + 2] = b;
+}
+
+static inline void store(const float *rgb, float *color) {
+	color[0] = rgb[0];
+	color[1] = rgb[1];
+	color[2] = rgb[2];
+}
+
+static inline void store(const float *rgb, unsigned char *color) {
+	color[0] = CurvatureColorMap::toByte(rgb[0]);
+	color[1] = CurvatureColorMap::toByte(rgb[1]);
+	color[2] = CurvatureColorMap::toByte(rgb[2]);
+}
+
+// One pass per curvature and color type
+template <class Scalar, class Color>
+static void applyAll(const CurvatureColorMap &map, const CurvatureMesh &mesh, const Scalar *curvature, double scale, Color *colors, unsigned int threadCount) {
+	const CurvatureTopology &topology = mesh.topology;
+
+	CurvatureThreadPool::instance().parallelFor(topology.drawCount(), kGrain, threadCount, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			float rgb[3];
+			map.lookup(curvature[topology.unique((unsigned int)i)], scale, rgb);
+			store(rgb, &colors[i * 3]);
+		}
+	});
+}
+
+void CurvatureColorMap::apply(const CurvatureMesh &mesh, double scale, float *colors, unsigned int threadCount) const {
+	if (mesh.curvatureF.empty())
+		applyAll(*this, mesh, mesh.curvature.data(), scale, colors, threadCount);
+	else
+		applyAll(*this, mesh, mesh.curvatureF.data(), scale, colors, threadCount);
+}
+
+void CurvatureColorMap::apply(const CurvatureMesh &mesh, double scale, unsigned char *colors, unsigned int threadCount) const {
+	if (mesh.curvatureF.empty())
+		applyAll(*this, mesh, mesh.curvature.data(), scale, colors, threadCount);
+	else
+		applyAll(*this, mesh, mesh.curvatureF.data(), scale, colors, threadCount);
+}
+
+// Calls fn(v, rgb) for every unique vertex of mesh.changed[first, last) and
+// writes rgb to its draw vertices
+template <class Color, class Fn>
+static void writeChanged(const CurvatureMesh &mesh, size_t first, size_t last, Color *colors, unsigned int threadCount, const Fn &fn) {
+	const CurvatureTopology &topology = mesh.topology;
+
+	CurvatureThreadPool::instance().parallelFor(last - first, kGrain, threadCount, [&](size_t begin, size_t end) {
+		for (size_t c = first + begin; c < first + end; c++) {
+			unsigned int v = mesh.changed[c];
+
+			float rgb[3];
+			fn(v, rgb);
+
+			Color color[3];
+			store(rgb, color);
+			for (unsigned int d = topology.drawBegin(v); d < topology.drawEnd(v); d++) {
+				Color *target = &colors[topology.drawVertex(d) * 3];
+				target[0] = color[0];
+				target[1] = color[1];
+				target[2] = color[2];
+			}
+		}
+	});
+}
+
+void CurvatureColorMap::applyChanged(const CurvatureMesh &mesh, size_t begin, size_t end, double scale, float *colors, unsigned int threadCount) const {
+	writeChanged(mesh, begin, end, colors, threadCount, [&](unsigned int v, float *rgb) {
+		lookup(mesh.curvatureAt(v), scale, rgb);
+	});
+}
+
+void CurvatureColorMap::applyChanged(const CurvatureMesh &mesh, size_t begin, size_t end, double scale, unsigned char *colors, unsigned int threadCount) const {
+	writeChanged(mesh, begin, end, colors, threadCount, [&](unsigned int v, float *rgb) {
+		lookup(mesh.curvatureAt(v), scale, rgb);
+	});
+}
+
+void CurvatureColorMap::fillChanged(const CurvatureMesh &mesh, size_t begin, size_t end, const float *fill, float *colors, unsigned int threadCount) {
+	writeChanged(mesh, begin, end, colors, threadCount, [&](unsigned int, float *rgb) {
+		store(fill, rgb);
+	});
+}
+
+void CurvatureColorMap::fillChanged(const CurvatureMesh &mesh, size_t begin, size_t end, const float *fill, unsigned char *colors, unsigned int threadCount) {
+	writeChanged(mesh, begin, end, colors, threadCount, [&](unsigned int, float *rgb) {
+		store(fill, rgb);
+	});
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// Color ramp baked into a fixed size lookup table. Curvature is mapped to
+// the ramp position curvature * scale + 0.5, clamped to [0, 1] like
+// MRampAttribute does, and interpolated linearly between table entries.
+
+#include <cstddef>
+#include <vector>
+
+class CurvatureMesh;
+
+class CurvatureColorMap {
+public:
+	static const unsigned int kSize = 1024;
+
+	// RGB of ramp position i / (kSize - 1)
+	void set(unsigned int i, float r, float g, float b);
+	bool isBaked() const { return !table.empty(); }
+
+	inline void lookup(double curvature, double scale, float *rgb) const;
+
+	// RGB in draw vertex order, ready to be copied into a color buffer, as
+	// floats or as bytes scaled to [0, 255]
+	void apply(const CurvatureMesh &mesh, double scale, float *colors, unsigned int threadCount) const;
+	void apply(const CurvatureMesh &mesh, double scale, unsigned char *colors, unsigned int threadCount) const;
+	// Same, rewriting only the draw vertices of mesh.changed[begin, end)
+	void applyChanged(const CurvatureMesh &mesh, size_t begin, size_t end, double scale, float *colors, unsigned int threadCount) const;
+	void applyChanged(const CurvatureMesh &mesh, size_t begin, size_t end, double scale, unsigned char *colors, unsigned int threadCount) const;
+	// Writes rgb to the draw vertices of mesh.changed[begin, end)
+	static void fillChanged(const CurvatureMesh &mesh, size_t begin, size_t end, const float *rgb, float *colors, unsigned int threadCount);
+	static void fillChanged(const CurvatureMesh &mesh, size_t begin, size_t end, const float *rgb, unsigned char *colors, unsigned int threadCount);
+
+	// Ramp channel clamped to [0, 1] as a byte
+	static inline unsigned char toByte(float value);
+
+	std::vector <float> table;
+};
+
+inline void CurvatureColorMap::lookup(double curvature, double scale, float *rgb) const {
+	float position = float(curvature * scale + 0.5) * (kSize - 1);
+
+	// Negated compare sends NaN to the start of the ramp
+	if (!(0 < position))
+		position = 0;
+	else if (kSize - 1 < position)
+		position = float(kSize - 1);
+
+	unsigned int index = (unsigned int)position;
+	if (kSize - 1 <= index)
+		index = kSize - 2;
+	float t = position - float(index);
+
+	const float *a = &table[index * 3];
+	rgb[0] = a[0] + (a[3] - a[0]) * t;
+	rgb[1] = a[1] + (a[4] - a[1]) * t;
+	rgb[2] = a[2] + (a[5] - a[2]) * t;
+}
+
+inline unsigned char CurvatureColorMap::toByte(float value) {
+	// Negated compare sends NaN to 0
+	if (!(0 < value))
+		return 0;
+	if (1 < value)
+		return 255;
+	return (unsigned char)(value * 255 + 0.5f);
+}
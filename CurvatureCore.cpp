@@ -0,0 +1,592 @@
+#include "CurvatureCore.h"
+#include "CurvatureThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const unsigned int kInvalid = ~0u;
+static const size_t kGrain = 1024;
+static const size_t kHashBlock = 16384;
+static const size_t kBuildChunk = size_t(1) << 26;
+
+double CurvatureVector::length() const {
+	return sqrt(x * x + y * y + z * z);
+}
+
+CurvatureVector CurvatureVector::normal() const {
+	CurvatureVector n(*this);
+	n.normalize();
+	return n;
+}
+
+void CurvatureVector::normalize() {
+	double len = length();
+	if (0 < len) {
+		x /= len;
+		y /= len;
+		z /= len;
+	}
+}
+
+CurvatureVector CurvatureVector::transformAsVector(const double m[4][4]) const {
+	return CurvatureVector(
+		x * m[0][0] + y * m[1][0] + z * m[2][0],
+		x * m[0][1] + y * m[1][1] + z * m[2][1],
+		x * m[0][2] + y * m[1][2] + z * m[2][2]);
+}
+
+CurvatureVector CurvatureVector::transformAsPoint(const double m[4][4]) const {
+	CurvatureVector p = transformAsVector(m);
+	p.x += m[3][0];
+	p.y += m[3][1];
+	p.z += m[3][2];
+	return p;
+}
+
+static inline uint64_t rotateLeft(uint64_t value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t curvatureHash(const void *data, size_t size, uint64_t seed) {
+	const uint64_t kMulA = 0x9E3779B97F4A7C15ull;
+	const uint64_t kMulB = 0xC2B2AE3D27D4EB4Full;
+
+	const unsigned char *bytes = (const unsigned char*)data;
+	uint64_t hash = seed ^ (size * kMulA);
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		hash = rotateLeft(hash ^ (word * kMulB), 31) * kMulA;
+	}
+
+	uint64_t tail = 0;
+	for (size_t t = 0; i + t < size; t++)
+		tail |= uint64_t(bytes[i + t]) << (t * 8);
+	hash = rotateLeft(hash ^ (tail * kMulB), 31) * kMulA;
+
+	// Final avalanche
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDull;
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ull;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+void curvatureVertexNormals(size_t indexCount, const unsigned int *indexArray, size_t vertexCount, const float *vertexArray, float *normalArray) {
+	std::vector <double> accum(vertexCount * 3, 0.0);
+
+	for (size_t t = 0; t + 2 < indexCount; t += 3) {
+		const float *a = &vertexArray[indexArray[t] * size_t(3)];
+		const float *b = &vertexArray[indexArray[t + 1] * size_t(3)];
+		const float *c = &vertexArray[indexArray[t + 2] * size_t(3)];
+		double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		for (unsigned int k = 0; k < 3; k++)
+			for (unsigned int axis = 0; axis < 3; axis++)
+				accum[indexArray[t + k] * size_t(3) + axis] += n[axis];
+	}
+
+	for (size_t v = 0; v < accum.size(); v += 3) {
+		double length = sqrt(accum[v] * accum[v] + accum[v + 1] * accum[v + 1] + accum[v + 2] * accum[v + 2]);
+		if (0 == length)
+			length = 1;
+		for (unsigned int axis = 0; axis < 3; axis++)
+			normalArray[v + axis] = float(accum[v + axis] / length);
+	}
+}
+
+template <class Index>
+uint64_t CurvatureTopology::fingerprint(int indexCount, const Index *indexArray, int vertexCount, const int *vertexIDs) {
+	uint64_t hash = curvatureHash(&vertexCount, sizeof(vertexCount), (NULL == vertexIDs) | (sizeof(Index) << 1));
+	if (NULL != vertexIDs)
+		hash = curvatureHash(vertexIDs, vertexCount * sizeof(int), hash);
+	return curvatureHash(indexArray, indexCount * sizeof(Index), hash);
+}
+
+template <class Index>
+bool CurvatureTopology::build(int indexCount, const Index *indexArray, int vertexCount, const int *vertexIDs) {
+	for (int i = 0; i < indexCount; i++)
+		if (vertexCount <= (int)indexArray[i])
+			return false;
+
+	ids.clear();
+	m_drawCount = vertexCount;
+	m_identity = NULL == vertexIDs;
+
+	// Merge draw vertices sharing a vertex ID
+	if (m_identity) {
+		std::vector <unsigned int>().swap(ids);
+		std::vector <unsigned int>().swap(drawToUnique);
+		std::vector <unsigned int>().swap(drawOffsets);
+		std::vector <unsigned int>().swap(drawVertices);
+		m_vertexCount = vertexCount;
+	}
+	else {
+		drawToUnique.resize(vertexCount);
+
+		unsigned int maxId = 0;
+		for (int i = 0; i < vertexCount; i++)
+			maxId = std::max(maxId, (unsigned int)vertexIDs[i]);
+
+		std::vector <unsigned int> idToUnique(vertexCount ? maxId + 1 : 0, kInvalid);
+		for (int i = 0; i < vertexCount; i++) {
+			unsigned int &unique = idToUnique[vertexIDs[i]];
+			if (kInvalid == unique) {
+				unique = (unsigned int)ids.size();
+				ids.push_back(vertexIDs[i]);
+			}
+			drawToUnique[i] = unique;
+		}
+		m_vertexCount = (unsigned int)ids.size();
+
+		// Draw vertices of each unique vertex, in ascending order
+		drawOffsets.assign(m_vertexCount + 1, 0);
+		for (int i = 0; i < vertexCount; i++)
+			drawOffsets[drawToUnique[i] + 1]++;
+		for (unsigned int v = 0; v < m_vertexCount; v++)
+			drawOffsets[v + 1] += drawOffsets[v];
+
+		std::vector <unsigned int> fill(drawOffsets.begin(), drawOffsets.end() - 1);
+		drawVertices.resize(vertexCount);
+		for (int i = 0; i < vertexCount; i++)
+			drawVertices[fill[drawToUnique[i]]++] = i;
+	}
+
+	unsigned int numVertices = m_vertexCount;
+
+	// Count both triangle edges of every corner by their start vertex
+	int numTriangles = indexCount / 3;
+
+	std::vector <size_t> rawOffsets(numVertices + 1, 0);
+	for (int i = 0; i < numTriangles * 3; i++)
+		rawOffsets[unique(indexArray[i]) + 1] += 2;
+	for (unsigned int v = 0; v < numVertices; v++)
+		rawOffsets[v + 1] += rawOffsets[v];
+
+	// Closed meshes list every neighbour twice
+	ringOffsets.resize(numVertices + 1);
+	rings.clear();
+	rings.reserve(rawOffsets[numVertices] / 2);
+
+	// Bucket the edges of a range of start vertices at a time, so the raw
+	// lists stay within kBuildChunk entries on huge meshes. Small meshes
+	// take a single pass over the index buffer.
+	std::vector <unsigned int> raw;
+	std::vector <size_t> rawFill;
+	std::vector <unsigned int> lastSeen(numVertices, kInvalid);
+
+	unsigned int chunkBegin = 0;
+	while (chunkBegin < numVertices) {
+		unsigned int chunkEnd = chunkBegin + 1;
+		while (chunkEnd < numVertices && rawOffsets[chunkEnd + 1] - rawOffsets[chunkBegin] <= kBuildChunk)
+			chunkEnd++;
+
+		size_t base = rawOffsets[chunkBegin];
+		raw.resize(rawOffsets[chunkEnd] - base);
+		rawFill.assign(rawOffsets.begin() + chunkBegin, rawOffsets.begin() + chunkEnd);
+
+		for (int i = 0; i < numTriangles * 3; i += 3) {
+			for (unsigned int t = 0; t < 3; t++) {
+				unsigned int idA = unique(indexArray[i + t]);
+				if (idA < chunkBegin || chunkEnd <= idA)
+					continue;
+				for (unsigned int v = 1; v <= 2; v++)
+					raw[rawFill[idA - chunkBegin]++ - base] = unique(indexArray[i + ((t + v) % 3)]);
+			}
+		}
+
+		// Drop repeated neighbours, keeping the first occurrence
+		for (unsigned int v = chunkBegin; v < chunkEnd; v++) {
+			ringOffsets[v] = (unsigned int)rings.size();
+			for (size_t e = rawOffsets[v]; e < rawOffsets[v + 1]; e++) {
+				unsigned int neighbour = raw[e - base];
+				if (lastSeen[neighbour] == v)
+					continue;
+				lastSeen[neighbour] = v;
+				rings.push_back(neighbour);
+			}
+		}
+
+		chunkBegin = chunkEnd;
+	}
+	ringOffsets[numVertices] = (unsigned int)rings.size();
+	rings.shrink_to_fit();
+
+	return true;
+}
+
+size_t CurvatureTopology::byteSize() const {
+	return (ids.capacity() + drawToUnique.capacity() + drawOffsets.capacity() + drawVertices.capacity() +
+		ringOffsets.capacity() + rings.capacity()) * sizeof(unsigned int);
+}
+
+template uint64_t CurvatureTopology::fingerprint(int, const unsigned short*, int, const int*);
+template uint64_t CurvatureTopology::fingerprint(int, const unsigned int*, int, const int*);
+template bool CurvatureTopology::build(int, const unsigned short*, int, const int*);
+template bool CurvatureTopology::build(int, const unsigned int*, int, const int*);
+
+uint64_t CurvatureMesh::contentHash(int vertexCount, const float *vertexArray, const float *normalArray, const double transform[4][4]) {
+	// Fixed size blocks hashed in parallel, then the block hashes
+	size_t floats = size_t(vertexCount) * 3;
+	size_t blocks = (floats + kHashBlock - 1) / kHashBlock;
+	m_blockHashes.resize(blocks * 2);
+
+	CurvatureThreadPool::instance().parallelFor(blocks, 1, threadCount, [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; b++) {
+			size_t size = std::min(kHashBlock, floats - b * kHashBlock) * sizeof(float);
+			m_blockHashes[b * 2 + 0] = curvatureHash(vertexArray + b * kHashBlock, size);
+			m_blockHashes[b * 2 + 1] = curvatureHash(normalArray + b * kHashBlock, size);
+		}
+	});
+
+	uint64_t hash = curvatureHash(transform, sizeof(double) * 16, kernel | (uint64_t(estimator) << 8) | (uint64_t(precision) << 16));
+	return curvatureHash(m_blockHashes.data(), m_blockHashes.size() * sizeof(uint64_t), hash);
+}
+
+template <class Index>
+bool CurvatureMesh::update(int indexCount, const Index *indexArray, int vertexCount, const float *vertexArray, const int *vertexIDs, const float *normalArray, const double transform[4][4]) {
+	if (!prepare(indexCount, indexArray, vertexCount, vertexArray, vertexIDs, normalArray, transform))
+		return false;
+
+	refine(remaining());
+	return true;
+}
+
+template <class Index>
+bool CurvatureMesh::prepare(int indexCount, const Index *indexArray, int vertexCount, const float *vertexArray, const int *vertexIDs, const float *normalArray, const double transform[4][4], uint64_t fingerprint) {
+	// Rebuild connectivity only when the index buffer or vertex IDs changed
+	bool rebuilt = false;
+	if (0 == fingerprint)
+		fingerprint = CurvatureTopology::fingerprint(indexCount, indexArray, vertexCount, vertexIDs);
+	if (!hasTopology || fingerprint != topologyFingerprint) {
+		CurvatureScope scope("topology", topologyTimer);
+		hasTopology = topology.build(indexCount, indexArray, vertexCount, vertexIDs);
+		topologyFingerprint = fingerprint;
+		if (!hasTopology) {
+			changed.clear();
+			refined = 0;
+			return false;
+		}
+		rebuilt = true;
+	}
+
+	// Cached vertices and curvature are meaningless without content, and
+	// another estimator's or precision's as well
+	if (!hasContent || estimator != m_lastEstimator || precision != m_lastPrecision)
+		rebuilt = true;
+	m_lastEstimator = estimator;
+	m_lastPrecision = precision;
+
+	if (kEstimatorEdge == estimator)
+		curvatureOperator.clear();
+	else if (!curvatureOperator.isBuilt() || m_operatorFingerprint != topologyFingerprint) {
+		CurvatureScope scope("operator", topologyTimer);
+		curvatureOperator.build(indexCount, indexArray, topology, threadCount);
+		m_operatorFingerprint = topologyFingerprint;
+	}
+
+	CurvatureScope scope("prepare", prepareTimer);
+	CurvatureThreadPool &pool = CurvatureThreadPool::instance();
+
+	// Nothing to do when the buffers are byte for byte the last ones
+	uint64_t hash = contentHash(vertexCount, vertexArray, normalArray, transform);
+	if (!rebuilt && hasContent && hash == lastContentHash) {
+		if (0 == remaining()) {
+			changed.clear();
+			refined = 0;
+		}
+		return true;
+	}
+	lastContentHash = hash;
+	hasContent = true;
+
+	unsigned int numVertices = topology.vertexCount();
+
+	if (rebuilt) {
+		if (kPrecisionFloat == precision) {
+			std::vector <double>().swap(curvature);
+			curvatureF.assign(numVertices, 0);
+		}
+		else {
+			std::vector <float>().swap(curvatureF);
+			curvature.assign(numVertices, 0);
+		}
+		pendingUnknown = true;
+	}
+	m_fullPass = rebuilt;
+
+	// A rebuild queues every vertex, the diff scratch is only needed after it
+	if (rebuilt) {
+		std::vector <unsigned char>().swap(m_moved);
+		std::vector <unsigned char>().swap(m_recompute);
+	}
+	else {
+		m_moved.resize(numVertices);
+		m_recompute.resize(numVertices);
+	}
+
+	if (kPrecisionFloat == precision)
+		diff(verticesF, normalsF, vertexArray, normalArray, transform, rebuilt);
+	else
+		diff(vertices, normals, vertexArray, normalArray, transform, rebuilt);
+
+	if (rebuilt) {
+		changed.resize(numVertices);
+		for (unsigned int v = 0; v < numVertices; v++)
+			changed[v] = v;
+		refined = 0;
+		return true;
+	}
+
+	// A moved vertex changes the edges of its whole one-ring. Rings are
+	// symmetric, so this gathers from the neighbours instead of scattering.
+	pool.parallelFor(numVertices, kGrain, threadCount, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			if (m_recompute[v])
+				continue;
+			for (unsigned int e = topology.ringOffsets[v]; e < topology.ringOffsets[v + 1]; e++) {
+				if (m_moved[topology.rings[e]]) {
+					m_recompute[v] = true;
+					break;
+				}
+			}
+		}
+	});
+
+	// Vertices still queued by an unfinished refinement stay queued
+	for (size_t c = refined; c < changed.size(); c++)
+		m_recompute[changed[c]] = true;
+
+	changed.clear();
+	refined = 0;
+	for (unsigned int v = 0; v < numVertices; v++)
+		if (m_recompute[v])
+			changed.push_back(v);
+
+	return true;
+}
+
+template <class Scalar>
+void CurvatureMesh::diff(CurvatureVectorArrayT <Scalar> &cachedVertices, CurvatureVectorArrayT <Scalar> &cachedNormals,
+	const float *vertexArray, const float *normalArray, const double transform[4][4], bool rebuilt) {
+	unsigned int numVertices = topology.vertexCount();
+
+	// Only the cache of the current precision is kept
+	if (rebuilt) {
+		vertices.clear();
+		normals.clear();
+		verticesF.clear();
+		normalsF.clear();
+		cachedVertices.assign(numVertices);
+		cachedNormals.assign(numVertices);
+	}
+
+	// Diff positions and averaged normals against the cached ones
+	CurvatureThreadPool::instance().parallelFor(numVertices, kGrain, threadCount, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			unsigned int drawBegin = topology.drawBegin(v), drawEnd = topology.drawEnd(v);
+
+			CurvatureVector vertex = CurvatureVector(&vertexArray[topology.drawVertex(drawBegin) * 3]).transformAsPoint(transform);
+			bool moved = rebuilt || !cachedVertices.equals(v, vertex);
+			if (moved)
+				cachedVertices.set(v, vertex);
+
+			CurvatureVector normal;
+			for (unsigned int d = drawBegin; d < drawEnd; d++)
+				normal += CurvatureVector(&normalArray[topology.drawVertex(d) * 3]);
+			normal = normal.transformAsVector(transform);
+			normal.normalize();
+
+			bool turned = !cachedNormals.equals(v, normal);
+			if (turned)
+				cachedNormals.set(v, normal);
+
+			if (!rebuilt) {
+				m_moved[v] = moved;
+				m_recompute[v] = moved || turned;
+			}
+		}
+	});
+}
+
+void CurvatureMesh::releaseChanged() {
+	if (!m_fullPass || 0 < remaining())
+		return;
+
+	std::vector <unsigned int>().swap(changed);
+	refined = 0;
+	m_fullPass = false;
+}
+
+size_t CurvatureMesh::byteSize() const {
+	size_t bytes = topology.byteSize() + curvatureOperator.byteSize() +
+		vertices.byteSize() + normals.byteSize() + verticesF.byteSize() + normalsF.byteSize() +
+		curvature.capacity() * sizeof(double) + curvatureF.capacity() * sizeof(float) +
+		changed.capacity() * sizeof(unsigned int) +
+		m_blockHashes.capacity() * sizeof(uint64_t) +
+		m_moved.capacity() + m_recompute.capacity();
+
+	for (const EdgeScratch &scratch : m_edgeScratch)
+		bytes += scratch.byteSize();
+	return bytes;
+}
+
+template <class Index>
+bool CurvatureMesh::assign(int indexCount, const Index *indexArray, int vertexCount, const int *vertexIDs, const float *values, size_t valueCount) {
+	hasContent = false;
+
+	uint64_t fingerprint = CurvatureTopology::fingerprint(indexCount, indexArray, vertexCount, vertexIDs);
+	if (!hasTopology || fingerprint != topologyFingerprint) {
+		CurvatureScope scope("topology", topologyTimer);
+		hasTopology = topology.build(indexCount, indexArray, vertexCount, vertexIDs);
+		topologyFingerprint = fingerprint;
+	}
+
+	unsigned int numVertices = topology.vertexCount();
+	bool valid = hasTopology;
+	for (unsigned int v = 0; valid && v < numVertices; v++)
+		valid = topology.id(v) < valueCount;
+
+	changed.clear();
+	refined = 0;
+	if (!valid)
+		return false;
+
+	bool single = kPrecisionFloat == precision;
+	if (single) {
+		std::vector <double>().swap(curvature);
+		curvatureF.resize(numVertices);
+	}
+	else {
+		std::vector <float>().swap(curvatureF);
+		curvature.resize(numVertices);
+	}
+	CurvatureThreadPool::instance().parallelFor(numVertices, kGrain, threadCount, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			if (single)
+				curvatureF[v] = values[topology.id(v)];
+			else
+				curvature[v] = values[topology.id(v)];
+		}
+	});
+
+	changed.resize(numVertices);
+	for (unsigned int v = 0; v < numVertices; v++)
+		changed[v] = v;
+	refined = numVertices;
+	pendingUnknown = false;
+	m_fullPass = true;
+
+	return true;
+}
+
+template bool CurvatureMesh::update(int, const unsigned short*, int, const float*, const int*, const float*, const double[4][4]);
+template bool CurvatureMesh::update(int, const unsigned int*, int, const float*, const int*, const float*, const double[4][4]);
+template bool CurvatureMesh::prepare(int, const unsigned short*, int, const float*, const int*, const float*, const double[4][4], uint64_t);
+template bool CurvatureMesh::prepare(int, const unsigned int*, int, const float*, const int*, const float*, const double[4][4], uint64_t);
+template bool CurvatureMesh::assign(int, const unsigned short*, int, const int*, const float*, size_t);
+template bool CurvatureMesh::assign(int, const unsigned int*, int, const int*, const float*, size_t);
+
+size_t CurvatureMesh::refine(size_t count) {
+	size_t first = refined;
+	size_t last = first + std::min(count, remaining());
+	if (first == last)
+		return remaining();
+
+	CurvatureScope scope("curvature", curvatureTimer);
+
+	// One specialization per precision and estimator, chosen once per pass
+	bool single = kPrecisionFloat == precision;
+	switch (estimator) {
+	case kEstimatorMean:
+		if (single)
+			refineOperator <float, kEstimatorMean>(verticesF, normalsF, curvatureF.data(), first, last);
+		else
+			refineOperator <double, kEstimatorMean>(vertices, normals, curvature.data(), first, last);
+		break;
+	case kEstimatorGaussian:
+		if (single)
+			refineOperator <float, kEstimatorGaussian>(verticesF, normalsF, curvatureF.data(), first, last);
+		else
+			refineOperator <double, kEstimatorGaussian>(vertices, normals, curvature.data(), first, last);
+		break;
+	default:
+		if (single)
+			refineEdges(verticesF, normalsF, curvatureF.data(), first, last);
+		else
+			refineEdges(vertices, normals, curvature.data(), first, last);
+		break;
+	}
+
+	refined = last;
+	if (0 == remaining())
+		pendingUnknown = false;
+
+	return remaining();
+}
+
+// Operator rows are independent, weights and all
+template <class Scalar, CurvatureEstimator Estimator>
+void CurvatureMesh::refineOperator(const CurvatureVectorArrayT <Scalar> &cachedVertices, const CurvatureVectorArrayT <Scalar> &cachedNormals, Scalar *field, size_t first, size_t last) {
+	CurvatureThreadPool::instance().parallelFor(last - first, kGrain, threadCount, [&](size_t begin, size_t end) {
+		for (size_t c = first + begin; c < first + end; c++) {
+			unsigned int v = changed[c];
+			field[v] = Scalar(kEstimatorMean == Estimator ?
+				curvatureOperator.mean(v, cachedVertices, cachedNormals) :
+				curvatureOperator.gaussian(v, cachedVertices));
+		}
+	});
+}
+
+template <class Scalar>
+void CurvatureMesh::refineEdges(const CurvatureVectorArrayT <Scalar> &cachedVertices, const CurvatureVectorArrayT <Scalar> &cachedNormals, Scalar *field, size_t first, size_t last) {
+	// Flatten the one-rings of each grain into an edge list for the kernel
+	CurvatureEdgeFuncT <Scalar> edgeFunc = curvatureEdgeFunc <Scalar>(kernel);
+	CurvatureEdgeStreamsT <Scalar> streams = cachedVertices.streams(cachedNormals);
+	m_edgeScratch.resize(CurvatureThreadPool::instance().size());
+
+	CurvatureThreadPool::instance().parallelFor(last - first, kGrain, threadCount, [&](size_t begin, size_t end) {
+		EdgeScratch &scratch = m_edgeScratch[CurvatureThreadPool::threadIndex()];
+		std::vector <Scalar> &values = scratch.valuesOf(Scalar());
+
+		// A serial call gets the whole range at once
+		for (size_t grain = first + begin; grain < first + end; grain += kGrain) {
+			size_t grainEnd = std::min(grain + kGrain, first + end);
+
+			scratch.from.clear();
+			scratch.to.clear();
+			for (size_t c = grain; c < grainEnd; c++) {
+				unsigned int idA = changed[c];
+				for (unsigned int e = topology.ringOffsets[idA]; e < topology.ringOffsets[idA + 1]; e++) {
+					scratch.from.push_back(idA);
+					scratch.to.push_back(topology.rings[e]);
+				}
+			}
+			values.resize(scratch.from.size());
+
+			// Compute edge curvature
+			edgeFunc(scratch.from.size(), scratch.from.data(), scratch.to.data(), streams, values.data());
+
+			// Calculate average curvature
+			const Scalar *value = values.data();
+			for (size_t c = grain; c < grainEnd; c++) {
+				unsigned int idA = changed[c];
+				unsigned int valence = topology.valence(idA);
+
+				double sum = 0;
+				for (unsigned int e = 0; e < valence; e++)
+					sum += *value++;
+
+				if (1 < valence)
+					sum /= valence;
+				field[idA] = Scalar(sum);
+			}
+		}
+	});
+}
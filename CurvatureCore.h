@@ -0,0 +1,275 @@
+#pragma once
+
+// Maya-free curvature estimator. Works on the raw position, normal and index
+// buffers handed to the shader so it can be built and profiled without Maya.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CurvatureOperator.h"
+#include "CurvatureProfiler.h"
+#include "CurvatureSimd.h"
+
+// Fast non-cryptographic 64-bit hash used to fingerprint buffers
+uint64_t curvatureHash(const void *data, size_t size, uint64_t seed = 0);
+
+// Area weighted face normals summed per vertex and normalized, for inputs
+// that come without normals. Every index must be below vertexCount.
+void curvatureVertexNormals(size_t indexCount, const unsigned int *indexArray, size_t vertexCount, const float *vertexArray, float *normalArray);
+
+struct CurvatureVector {
+	double x = 0, y = 0, z = 0;
+
+	CurvatureVector() {}
+	CurvatureVector(double x, double y, double z) : x(x), y(y), z(z) {}
+	CurvatureVector(const float *v) : x(v[0]), y(v[1]), z(v[2]) {}
+
+	CurvatureVector operator+(const CurvatureVector &v) const { return CurvatureVector(x + v.x, y + v.y, z + v.z); }
+	CurvatureVector operator-(const CurvatureVector &v) const { return CurvatureVector(x - v.x, y - v.y, z - v.z); }
+	CurvatureVector& operator+=(const CurvatureVector &v) { x += v.x; y += v.y; z += v.z; return *this; }
+	double operator*(const CurvatureVector &v) const { return x * v.x + y * v.y + z * v.z; }
+	bool operator==(const CurvatureVector &v) const { return x == v.x && y == v.y && z == v.z; }
+
+	double length() const;
+	CurvatureVector normal() const;
+	void normalize();
+
+	// Row vector times the upper 3x3 of a Maya style 4x4 matrix
+	CurvatureVector transformAsVector(const double m[4][4]) const;
+	CurvatureVector transformAsPoint(const double m[4][4]) const;
+};
+
+// Structure of arrays of 3D vectors, the layout the edge kernels stream.
+// Scalar is double, or float to halve the bytes streamed. Vectors are set
+// and compared rounded to Scalar.
+template <class Scalar>
+struct CurvatureVectorArrayT {
+	std::vector <Scalar> x, y, z;
+
+	size_t size() const { return x.size(); }
+	size_t byteSize() const { return (x.capacity() + y.capacity() + z.capacity()) * sizeof(Scalar); }
+	void assign(size_t count) { x.assign(count, 0); y.assign(count, 0); z.assign(count, 0); }
+	void clear() { std::vector <Scalar>().swap(x); std::vector <Scalar>().swap(y); std::vector <Scalar>().swap(z); }
+
+	CurvatureVector get(size_t i) const { return CurvatureVector(x[i], y[i], z[i]); }
+	void set(size_t i, const CurvatureVector &v) { x[i] = Scalar(v.x); y[i] = Scalar(v.y); z[i] = Scalar(v.z); }
+	bool equals(size_t i, const CurvatureVector &v) const { return x[i] == Scalar(v.x) && y[i] == Scalar(v.y) && z[i] == Scalar(v.z); }
+
+	CurvatureEdgeStreamsT <Scalar> streams(const CurvatureVectorArrayT &normals) const {
+		CurvatureEdgeStreamsT <Scalar> result = { x.data(), y.data(), z.data(), normals.x.data(), normals.y.data(), normals.z.data() };
+		return result;
+	}
+};
+typedef CurvatureVectorArrayT <double> CurvatureVectorArray;
+typedef CurvatureVectorArrayT <float> CurvatureVectorArrayF;
+
+// Connectivity derived from the index buffer. Draw vertices sharing an ID in
+// vertexIDs are merged into one unique vertex, and every unique vertex gets
+// the neighbours it shares a triangle with, stored CSR style in order of
+// first appearance so the per-vertex sums match a walk over the triangles.
+// Without vertexIDs every draw vertex is unique, the mappings between draw
+// and unique vertices are the identity and their arrays are left empty, so
+// they are read through id(), unique() and the draw range accessors.
+class CurvatureTopology {
+public:
+	// Returns false when the index buffer references vertices outside of
+	// the vertex range. A NULL vertexIDs means every draw vertex is unique.
+	// Index is unsigned short or unsigned int, instantiated in the .cpp.
+	template <class Index>
+	bool build(int indexCount,
+		const Index *indexArray,
+		int vertexCount,
+		const int *vertexIDs);
+
+	// Cheap identity of the inputs build() depends on
+	template <class Index>
+	static uint64_t fingerprint(int indexCount,
+		const Index *indexArray,
+		int vertexCount,
+		const int *vertexIDs);
+
+	unsigned int vertexCount() const { return m_vertexCount; }
+	unsigned int drawCount() const { return m_drawCount; }
+	bool isIdentity() const { return m_identity; }
+	size_t byteSize() const;
+	unsigned int valence(unsigned int vtx) const { return ringOffsets[vtx + 1] - ringOffsets[vtx]; }
+
+	unsigned int id(unsigned int vtx) const { return m_identity ? vtx : ids[vtx]; }
+	unsigned int unique(unsigned int draw) const { return m_identity ? draw : drawToUnique[draw]; }
+	unsigned int drawBegin(unsigned int vtx) const { return m_identity ? vtx : drawOffsets[vtx]; }
+	unsigned int drawEnd(unsigned int vtx) const { return m_identity ? vtx + 1 : drawOffsets[vtx + 1]; }
+	unsigned int drawVertex(unsigned int d) const { return m_identity ? d : drawVertices[d]; }
+
+	std::vector <unsigned int> ids;				// Mesh vertex ID of each unique vertex
+	std::vector <unsigned int> drawToUnique;	// Unique vertex of each draw vertex
+
+	std::vector <unsigned int> drawOffsets;		// Draw vertices of each unique vertex
+	std::vector <unsigned int> drawVertices;
+
+	std::vector <unsigned int> ringOffsets;
+	std::vector <unsigned int> rings;
+
+private:
+	unsigned int m_vertexCount = 0;
+	unsigned int m_drawCount = 0;
+	bool m_identity = false;
+};
+
+// What CurvatureMesh computes per vertex. The edge estimator averages the
+// normal curvature of the one-ring edges, the others apply the sparse
+// operators of CurvatureOperator.h.
+enum CurvatureEstimator {
+	kEstimatorEdge,
+	kEstimatorMean,
+	kEstimatorGaussian
+};
+
+// Scalar type of the cached positions, normals and curvature and of the edge
+// kernels. Curvature is accumulated in double either way.
+enum CurvaturePrecision {
+	kPrecisionDouble,
+	kPrecisionFloat
+};
+
+class CurvatureMesh {
+public:
+	// Recomputes curvature for vertices affected by changes since the last
+	// call. Returns false when the index buffer references vertices outside
+	// of vertexArray. Cached results are left untouched in that case.
+	// vertexIDs may be NULL when every draw vertex is its own vertex.
+	// Unchanged buffers return right after hashing them, with an empty
+	// changed list. Index is unsigned short or unsigned int.
+	template <class Index>
+	bool update(int indexCount,
+		const Index *indexArray,
+		int vertexCount,
+		const float *vertexArray,
+		const int *vertexIDs,
+		const float *normalArray,
+		const double transform[4][4]);
+
+	// update split in two for progressive refinement. prepare takes the same
+	// arguments and does everything but the curvature: it queues the affected
+	// vertices in changed, keeping those an unfinished refinement left over.
+	// refine computes up to count queued vertices and returns how many remain.
+	// A caller that already hashed the topology passes its
+	// CurvatureTopology::fingerprint, 0 has prepare compute it.
+	template <class Index>
+	bool prepare(int indexCount,
+		const Index *indexArray,
+		int vertexCount,
+		const float *vertexArray,
+		const int *vertexIDs,
+		const float *normalArray,
+		const double transform[4][4],
+		uint64_t fingerprint = 0);
+	size_t refine(size_t count);
+	size_t remaining() const { return changed.size() - refined; }
+
+	// Frees changed once a finished pass that queued every vertex has been
+	// colored. Incremental passes keep it, so steady updates don't allocate.
+	void releaseChanged();
+
+	// Takes curvature computed elsewhere, e.g. baked per frame, instead of
+	// computing it. values are per mesh vertex ID, or per draw vertex when
+	// vertexIDs is NULL. The topology is built like in prepare and every
+	// vertex is queued as refined. The next prepare starts over, as the
+	// cached positions and normals don't match the values. Returns false
+	// when an index or vertex ID is out of range.
+	template <class Index>
+	bool assign(int indexCount,
+		const Index *indexArray,
+		int vertexCount,
+		const int *vertexIDs,
+		const float *values,
+		size_t valueCount);
+
+	// Heap memory held, topology included
+	size_t byteSize() const;
+
+	// Per unique vertex, see CurvatureTopology. Positions, normals and
+	// curvature are kept in vertices, normals and curvature, or verticesF,
+	// normalsF and curvatureF in float precision, the others are left empty.
+	CurvatureVectorArray vertices;
+	CurvatureVectorArray normals;
+	CurvatureVectorArrayF verticesF;
+	CurvatureVectorArrayF normalsF;
+	std::vector <double> curvature;
+	std::vector <float> curvatureF;
+
+	// Curvature of unique vertex v in either precision
+	double curvatureAt(unsigned int v) const { return curvatureF.empty() ? curvature[v] : curvatureF[v]; }
+
+	// Unique vertices queued by the last update or prepare: the moved ones,
+	// their one-rings and those with a changed normal. The first `refined`
+	// of them have their curvature recomputed, the others keep the previous
+	// value, which is 0 when pendingUnknown.
+	std::vector <unsigned int> changed;
+	size_t refined = 0;
+	bool pendingUnknown = false;
+
+	// 0 uses every core of CurvatureThreadPool, 1 runs serially
+	unsigned int threadCount = 0;
+
+	// Edge kernel, see CurvatureSimd.h
+	CurvatureKernel kernel = curvatureBestKernel();
+
+	// Switching either recomputes every vertex on the next prepare
+	CurvatureEstimator estimator = kEstimatorEdge;
+	CurvaturePrecision precision = kPrecisionDouble;
+
+	// Kept across updates, rebuilt only when the fingerprint changes
+	CurvatureTopology topology;
+	uint64_t topologyFingerprint = 0;
+	bool hasTopology = false;
+
+	// Built from the topology for the operator estimators only
+	CurvatureOperator curvatureOperator;
+
+	// Hash of the last processed positions, normals, transform, kernel,
+	// estimator and precision.
+	// Without content the next prepare recomputes every vertex.
+	uint64_t lastContentHash = 0;
+	bool hasContent = false;
+
+	// Topology builds, buffer hashing and diffing in prepare, refine passes
+	CurvatureTimer topologyTimer;
+	CurvatureTimer prepareTimer;
+	CurvatureTimer curvatureTimer;
+
+private:
+	uint64_t contentHash(int vertexCount, const float *vertexArray, const float *normalArray, const double transform[4][4]);
+
+	// Specializations of the diff and refine passes, one per scalar type and
+	// estimator, picked by precision and estimator
+	template <class Scalar>
+	void diff(CurvatureVectorArrayT <Scalar> &cachedVertices, CurvatureVectorArrayT <Scalar> &cachedNormals,
+		const float *vertexArray, const float *normalArray, const double transform[4][4], bool rebuilt);
+	template <class Scalar>
+	void refineEdges(const CurvatureVectorArrayT <Scalar> &cachedVertices, const CurvatureVectorArrayT <Scalar> &cachedNormals, Scalar *field, size_t first, size_t last);
+	template <class Scalar, CurvatureEstimator Estimator>
+	void refineOperator(const CurvatureVectorArrayT <Scalar> &cachedVertices, const CurvatureVectorArrayT <Scalar> &cachedNormals, Scalar *field, size_t first, size_t last);
+
+	CurvatureEstimator m_lastEstimator = kEstimatorEdge;
+	CurvaturePrecision m_lastPrecision = kPrecisionDouble;
+	uint64_t m_operatorFingerprint = 0;
+	bool m_fullPass = false;
+
+	std::vector <uint64_t> m_blockHashes;
+	std::vector <unsigned char> m_moved;
+	std::vector <unsigned char> m_recompute;
+
+	// Edge list refineEdges hands to the kernel, one per pool thread and
+	// bounded by a grain of vertices, see CurvatureThreadPool::threadIndex
+	struct EdgeScratch {
+		std::vector <unsigned int> from, to;
+		std::vector <double> values;
+		std::vector <float> valuesF;
+
+		std::vector <double>& valuesOf(double) { return values; }
+		std::vector <float>& valuesOf(float) { return valuesF; }
+		size_t byteSize() const { return (from.capacity() + to.capacity()) * sizeof(unsigned int) + values.capacity() * sizeof(double) + valuesF.capacity() * sizeof(float); }
+	};
+	std::vector <EdgeScratch> m_edgeScratch;
+};
@@ -0,0 +1,223 @@
+#include "CurvatureDiskCache.h"
+#include "CurvatureFile.h"
+#include "CurvatureThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+static const char kMagic[4] = { 'C', 'R', 'V', 'C' };
+static const uint32_t kVersion = 1;
+static const char *kExtension = ".crv";
+
+// Temporary files older than this are left over from a crashed writer
+static const int64_t kStaleMicroseconds = 3600ll * 1000000;
+
+// In host byte order, the values follow 8 byte aligned: doubles, or floats
+// for a mesh in float precision, which is part of the key
+struct CurvatureDiskHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint64_t count;
+};
+
+static bool endsWith(const std::string &text, const char *suffix) {
+	size_t length = strlen(suffix);
+	return length <= text.size() && 0 == text.compare(text.size() - length, length, suffix);
+}
+
+// Listings may use either separator on Windows
+static std::string fileName(const std::string &path) {
+	size_t separator = path.find_last_of("/\\");
+	return std::string::npos == separator ? path : path.substr(separator + 1);
+}
+
+CurvatureDiskCache& CurvatureDiskCache::instance() {
+	static CurvatureDiskCache cache;
+	return cache;
+}
+
+void CurvatureDiskCache::configure(const std::string &directory, size_t maxBytes) {
+	std::lock_guard <std::mutex> lock(m_mutex);
+
+	m_directory = directory;
+	while (1 < m_directory.size() && ('/' == m_directory.back() || '\\' == m_directory.back()))
+		m_directory.pop_back();
+	m_maxBytes = maxBytes;
+
+	if (!m_directory.empty() && !curvatureMakeDirectory(m_directory))
+		fprintf(stderr, "curvatureShader: can't create the cache directory %s\n", m_directory.c_str());
+}
+
+bool CurvatureDiskCache::isEnabled() {
+	std::lock_guard <std::mutex> lock(m_mutex);
+	return !m_directory.empty();
+}
+
+uint64_t CurvatureDiskCache::key(const CurvatureMesh &mesh) {
+	return curvatureHash(&mesh.lastContentHash, sizeof(mesh.lastContentHash), mesh.topologyFingerprint);
+}
+
+std::string CurvatureDiskCache::filePath(uint64_t key, size_t *maxBytes) {
+	std::lock_guard <std::mutex> lock(m_mutex);
+	if (m_directory.empty())
+		return std::string();
+
+	if (maxBytes)
+		*maxBytes = m_maxBytes;
+
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx", (unsigned long long)key);
+	return m_directory + name + kExtension;
+}
+
+bool CurvatureDiskCache::load(CurvatureMesh &mesh) {
+	if (!mesh.pendingUnknown || !mesh.hasTopology || !mesh.hasContent)
+		return false;
+
+	uint64_t fieldKey = key(mesh);
+	std::string path = filePath(fieldKey, NULL);
+	if (path.empty())
+		return false;
+
+	size_t count = mesh.topology.vertexCount();
+	bool single = kPrecisionFloat == mesh.precision;
+	size_t valueSize = single ? sizeof(float) : sizeof(double);
+	CurvatureDiskHeader header;
+
+	CurvatureMappedFile file;
+	if (!file.open(path) || sizeof(header) + count * valueSize != file.size()) {
+		misses++;
+		return false;
+	}
+
+	memcpy(&header, file.data(), sizeof(header));
+	if (0 != memcmp(header.magic, kMagic, sizeof(kMagic)) || kVersion != header.version || fieldKey != header.key || count != header.count) {
+		misses++;
+		return false;
+	}
+
+	void *values;
+	if (single) {
+		mesh.curvatureF.resize(count);
+		values = mesh.curvatureF.data();
+	}
+	else {
+		mesh.curvature.resize(count);
+		values = mesh.curvature.data();
+	}
+	memcpy(values, file.data() + sizeof(header), count * valueSize);
+	mesh.refined = mesh.changed.size();
+	mesh.pendingUnknown = false;
+
+	file.close();
+	curvatureTouchFile(path);
+	hits++;
+	return true;
+}
+
+bool CurvatureDiskCache::isStorable(const CurvatureMesh &mesh) {
+	return !mesh.pendingUnknown && 0 == mesh.remaining() && mesh.hasTopology && mesh.hasContent;
+}
+
+bool CurvatureDiskCache::store(const CurvatureMesh &mesh) {
+	if (!isStorable(mesh))
+		return false;
+
+	bool single = kPrecisionFloat == mesh.precision;
+	if (single)
+		return write(key(mesh), mesh.curvatureF.data(), sizeof(float), mesh.curvatureF.size());
+	return write(key(mesh), mesh.curvature.data(), sizeof(double), mesh.curvature.size());
+}
+
+void CurvatureDiskCache::storeAsync(const CurvatureMesh &mesh) {
+	if (!isStorable(mesh) || !isEnabled())
+		return;
+
+	uint64_t fieldKey = key(mesh);
+	if (kPrecisionFloat == mesh.precision) {
+		std::vector <float> values(mesh.curvatureF);
+		CurvatureThreadPool::instance().post([this, fieldKey, values]() {
+			write(fieldKey, values.data(), sizeof(float), values.size());
+		});
+	}
+	else {
+		std::vector <double> values(mesh.curvature);
+		CurvatureThreadPool::instance().post([this, fieldKey, values]() {
+			write(fieldKey, values.data(), sizeof(double), values.size());
+		});
+	}
+}
+
+bool CurvatureDiskCache::write(uint64_t fieldKey, const void *values, size_t valueSize, uint64_t count) {
+	size_t maxBytes = 0;
+	std::string path = filePath(fieldKey, &maxBytes);
+	if (path.empty())
+		return false;
+
+	// Written aside and renamed, so readers in this or another session never see a partial file
+	std::string temp;
+	{
+		std::lock_guard <std::mutex> lock(m_mutex);
+		long long now = (long long)std::chrono::steady_clock::now().time_since_epoch().count();
+		temp = path + ".tmp" + std::to_string(now) + "_" + std::to_string(m_tempCount++);
+	}
+
+	CurvatureDiskHeader header;
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.key = fieldKey;
+	header.count = count;
+
+	FILE *file = fopen(temp.c_str(), "wb");
+	if (NULL == file)
+		return false;
+
+	bool written = 1 == fwrite(&header, sizeof(header), 1, file) &&
+		header.count == fwrite(values, valueSize, header.count, file);
+	written = 0 == fclose(file) && written;
+
+	if (!written || !curvatureReplaceFile(temp, path)) {
+		remove(temp.c_str());
+		return false;
+	}
+
+	stores++;
+	evict(path.substr(0, path.find_last_of('/')), fileName(path), maxBytes);
+	return true;
+}
+
+void CurvatureDiskCache::evict(const std::string &directory, const std::string &keep, size_t maxBytes) {
+	std::lock_guard <std::mutex> lock(m_evictMutex);
+
+	std::vector <CurvatureFileInfo> files;
+	curvatureListDirectory(directory, files);
+
+	int64_t staleTime = int64_t(time(NULL)) * 1000000 - kStaleMicroseconds;
+	std::vector <CurvatureFileInfo> fields;
+	uint64_t total = 0;
+	for (const CurvatureFileInfo &file : files) {
+		if (endsWith(file.path, kExtension)) {
+			fields.push_back(file);
+			total += file.size;
+		}
+		else if (std::string::npos != file.path.find(std::string(kExtension) + ".tmp") && file.modified < staleTime)
+			remove(file.path.c_str());
+	}
+
+	if (total <= maxBytes)
+		return;
+
+	// Least recently used first, see load()
+	std::sort(fields.begin(), fields.end(), [](const CurvatureFileInfo &a, const CurvatureFileInfo &b) {
+		return a.modified != b.modified ? a.modified < b.modified : a.path < b.path;
+	});
+
+	for (size_t i = 0; i < fields.size() && maxBytes < total; i++)
+		if (keep != fileName(fields[i].path) && 0 == remove(fields[i].path.c_str()))
+			total -= fields[i].size;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Optional on-disk cache of whole curvature fields, so reopening a scene
+// doesn't recompute every mesh on its first draw. There is one file per
+// field, named after a hash of the topology fingerprint and the content hash
+// (positions, normals, scale transform, kernel, estimator and precision),
+// holding a small header and the raw per unique vertex values, doubles or
+// floats like the mesh's, which are memory-mapped on load.
+// Loading a file marks it as most recently used, storing one evicts the least
+// recently used files until the directory fits the size cap.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "CurvatureCore.h"
+
+class CurvatureDiskCache {
+public:
+	static CurvatureDiskCache& instance();
+
+	// An empty directory disables the cache. The directory is created if needed.
+	void configure(const std::string &directory, size_t maxBytes);
+	bool isEnabled();
+
+	// Fills in the curvature after a prepare that left it unknown (see
+	// CurvatureMesh::pendingUnknown) and marks every queued vertex refined.
+	// False on a miss, the mesh is untouched then.
+	bool load(CurvatureMesh &mesh);
+	// Writes the curvature of a mesh with nothing left to refine
+	bool store(const CurvatureMesh &mesh);
+	// Same from a copy of the curvature, written on the CurvatureThreadPool
+	// background thread so the caller doesn't wait for the disk
+	void storeAsync(const CurvatureMesh &mesh);
+
+	std::atomic <unsigned long long> hits{ 0 };
+	std::atomic <unsigned long long> misses{ 0 };
+	std::atomic <unsigned long long> stores{ 0 };
+
+private:
+	CurvatureDiskCache() {}
+
+	static uint64_t key(const CurvatureMesh &mesh);
+	static bool isStorable(const CurvatureMesh &mesh);
+	std::string filePath(uint64_t key, size_t *maxBytes);
+	// count values of valueSize bytes
+	bool write(uint64_t key, const void *values, size_t valueSize, uint64_t count);
+	// Never removes the file named keep, the one just stored
+	void evict(const std::string &directory, const std::string &keep, size_t maxBytes);
+
+	std::mutex m_mutex;
+	std::mutex m_evictMutex;
+	std::string m_directory;
+	size_t m_maxBytes = 0;
+	unsigned long long m_tempCount = 0;
+};
@@ -0,0 +1,189 @@
+#include "CurvatureFile.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#ifdef _WIN32
+bool CurvatureMappedFile::open(const std::string &path, bool sequential) {
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+		sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == file)
+		return false;
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		close();
+		return false;
+	}
+	m_size = size_t(size.QuadPart);
+	if (0 == m_size)
+		return true;
+
+	m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL != m_mapping)
+		m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (NULL == m_data) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void CurvatureMappedFile::close() {
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+	m_data = NULL;
+	m_mapping = NULL;
+	m_file = NULL;
+	m_size = 0;
+}
+
+// FILETIME counts 100ns intervals since 1601
+static int64_t unixTime(const FILETIME &time) {
+	int64_t ticks = (int64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	return ticks / 10 - 11644473600000000ll;
+}
+
+bool curvatureIsDirectory(const std::string &path) {
+	DWORD attributes = GetFileAttributesA(path.c_str());
+	return INVALID_FILE_ATTRIBUTES != attributes && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+bool curvatureMakeDirectory(const std::string &path) {
+	return CreateDirectoryA(path.c_str(), NULL) || curvatureIsDirectory(path);
+}
+
+void curvatureListDirectory(const std::string &dir, std::vector <CurvatureFileInfo> &files) {
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((dir + "\\*").c_str(), &found);
+	if (INVALID_HANDLE_VALUE == search)
+		return;
+	do {
+		if ((found.dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_HIDDEN)) || '.' == found.cFileName[0])
+			continue;
+		CurvatureFileInfo info;
+		info.path = dir + "\\" + found.cFileName;
+		info.size = (uint64_t(found.nFileSizeHigh) << 32) | found.nFileSizeLow;
+		info.modified = unixTime(found.ftLastWriteTime);
+		files.push_back(info);
+	} while (FindNextFileA(search, &found));
+	FindClose(search);
+}
+
+bool curvatureTouchFile(const std::string &path) {
+	HANDLE file = CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == file)
+		return false;
+
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	BOOL touched = SetFileTime(file, NULL, NULL, &now);
+	CloseHandle(file);
+	return FALSE != touched;
+}
+
+bool curvatureReplaceFile(const std::string &from, const std::string &to) {
+	return FALSE != MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING);
+}
+#else
+bool CurvatureMappedFile::open(const std::string &path, bool sequential) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (0 != fstat(fd, &info)) {
+		::close(fd);
+		return false;
+	}
+	m_size = size_t(info.st_size);
+	if (0 == m_size) {
+		::close(fd);
+		return true;
+	}
+
+	// The mapping keeps the file open
+	void *data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (MAP_FAILED == data) {
+		m_size = 0;
+		return false;
+	}
+
+	if (sequential)
+		madvise(data, m_size, MADV_SEQUENTIAL);
+	m_data = (const char*)data;
+	return true;
+}
+
+void CurvatureMappedFile::close() {
+	if (m_data)
+		munmap((void*)m_data, m_size);
+	m_data = NULL;
+	m_size = 0;
+}
+
+bool curvatureIsDirectory(const std::string &path) {
+	struct stat info;
+	return 0 == stat(path.c_str(), &info) && S_ISDIR(info.st_mode);
+}
+
+bool curvatureMakeDirectory(const std::string &path) {
+	return 0 == mkdir(path.c_str(), 0777) || curvatureIsDirectory(path);
+}
+
+void curvatureListDirectory(const std::string &dir, std::vector <CurvatureFileInfo> &files) {
+	DIR *handle = opendir(dir.c_str());
+	if (NULL == handle)
+		return;
+	while (struct dirent *entry = readdir(handle)) {
+		if ('.' == entry->d_name[0])
+			continue;
+
+		CurvatureFileInfo file;
+		file.path = dir + "/" + entry->d_name;
+
+		struct stat info;
+		if (0 != stat(file.path.c_str(), &info) || !S_ISREG(info.st_mode))
+			continue;
+		file.size = uint64_t(info.st_size);
+#ifdef __APPLE__
+		file.modified = int64_t(info.st_mtimespec.tv_sec) * 1000000 + info.st_mtimespec.tv_nsec / 1000;
+#else
+		file.modified = int64_t(info.st_mtim.tv_sec) * 1000000 + info.st_mtim.tv_nsec / 1000;
+#endif
+		files.push_back(file);
+	}
+	closedir(handle);
+}
+
+bool curvatureTouchFile(const std::string &path) {
+	return 0 == utime(path.c_str(), NULL);
+}
+
+bool curvatureReplaceFile(const std::string &from, const std::string &to) {
+	return 0 == rename(from.c_str(), to.c_str());
+}
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+// Small portable file helpers for the batch tool and the disk cache:
+// read-only mappings, directory listings and atomic replacement.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only mapping of a whole file, pages are read in as they are touched
+class CurvatureMappedFile {
+public:
+	CurvatureMappedFile() {}
+	~CurvatureMappedFile() { close(); }
+
+	CurvatureMappedFile(const CurvatureMappedFile&) = delete;
+	CurvatureMappedFile& operator=(const CurvatureMappedFile&) = delete;
+
+	// sequential hints the OS to read ahead and drop the pages behind
+	bool open(const std::string &path, bool sequential = false);
+	void close();
+
+	// NULL for an empty file
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	const char *m_data = NULL;
+	size_t m_size = 0;
+	void *m_file = NULL;
+	void *m_mapping = NULL;
+};
+
+struct CurvatureFileInfo {
+	std::string path;
+	uint64_t size;
+	int64_t modified;	// Microseconds since the epoch
+};
+
+bool curvatureIsDirectory(const std::string &path);
+// Creates the last component of path, true if it exists afterwards
+bool curvatureMakeDirectory(const std::string &path);
+// Regular files directly in dir, hidden ones skipped, unsorted
+void curvatureListDirectory(const std::string &dir, std::vector <CurvatureFileInfo> &files);
+
+// Sets the modification time to now
+bool curvatureTouchFile(const std::string &path);
+// Renames from over to, replacing it atomically where the OS allows
+bool curvatureReplaceFile(const std::string &from, const std::string &to);
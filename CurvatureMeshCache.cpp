@@ -0,0 +1,135 @@
+#include "CurvatureMeshCache.h"
+#include "CurvatureShader.h"
+
+#include <cmath>
+#include <cstring>
+
+bool CurvatureMeshKey::operator==(const CurvatureMeshKey &other) const {
+	return node == other.node && component == other.component && kernel == other.kernel && estimator == other.estimator && precision == other.precision && 0 == memcmp(scale, other.scale, sizeof(scale));
+}
+
+size_t CurvatureMeshKeyHash::operator()(const CurvatureMeshKey &key) const {
+	return size_t(curvatureHash(key.scale, sizeof(key.scale), key.node.hashCode() ^ key.component ^ (uint64_t(key.kernel) << 24) ^ (uint64_t(key.estimator) << 32) ^ (uint64_t(key.precision) << 40)));
+}
+
+CurvatureMeshEntry::CurvatureMeshEntry(const CurvatureMeshKey &key) : busy(false), key(key) {
+	mesh.kernel = key.kernel;
+	mesh.estimator = key.estimator;
+	mesh.precision = key.precision;
+
+	MObject node = this->key.node.object();
+	callbacks.append(MNodeMessage::addNodeDirtyPlugCallback(node, CurvatureShader::nodeDirty, this));
+}
+
+CurvatureMeshEntry::~CurvatureMeshEntry() {
+	MMessage::removeCallbacks(callbacks);
+}
+
+size_t CurvatureMeshEntry::byteSize() const {
+	size_t bytes = mesh.byteSize() +
+		indices.capacity() * sizeof(unsigned int) +
+		(vertices.capacity() + normals.capacity()) * sizeof(float) +
+		vertexIDs.capacity() * sizeof(int);
+
+	bytes += frameValues.capacity() * sizeof(float);
+	for (auto &frame : frames)
+		bytes += frame.second.capacity() * sizeof(float);
+	return bytes;
+}
+
+void CurvatureMeshEntry::finishUpdate() {
+	// Notified under the lock, a waiter may delete the entry as soon as it is released
+	std::lock_guard <std::mutex> lock(m_updateMutex);
+	busy = false;
+	m_updateDone.notify_all();
+}
+
+void CurvatureMeshEntry::waitUpdate() {
+	std::unique_lock <std::mutex> lock(m_updateMutex);
+	m_updateDone.wait(lock, [this] { return !busy; });
+}
+
+// 6000 fps ticks are whole numbers for every common frame rate
+long long CurvatureMeshEntry::frameKey(const MTime &time) {
+	return (long long)floor(time.as(MTime::k6000FPS) + 0.5);
+}
+
+CurvatureMeshCache& CurvatureMeshCache::instance() {
+	static CurvatureMeshCache cache;
+	return cache;
+}
+
+CurvatureMeshEntry* CurvatureMeshCache::acquire(const MObject &shape, uint64_t component, const double scale[4][4], CurvatureKernel kernel,
+	CurvatureEstimator estimator, CurvaturePrecision precision, CurvatureMeshEntry *previous) {
+	CurvatureMeshKey key;
+	key.node = MObjectHandle(shape);
+	key.component = component;
+	memcpy(key.scale, scale, sizeof(key.scale));
+	key.kernel = kernel;
+	key.estimator = estimator;
+	key.precision = precision;
+
+	std::lock_guard <std::mutex> lock(m_mutex);
+
+	auto found = m_entries.find(key);
+	if (m_entries.end() != found) {
+		found->second->refs++;
+		return found->second;
+	}
+
+	// Animated scale: everything but the scale matches, so the topology
+	// still holds and only the curvature starts over
+	if (NULL != previous && 1 == previous->refs && !previous->busy && !previous->pending &&
+		previous->key.node == key.node && previous->key.component == component && previous->key.kernel == kernel &&
+		previous->key.estimator == estimator && previous->key.precision == precision) {
+		m_entries.erase(previous->key);
+		previous->key = key;
+		previous->mesh.hasContent = false;
+		previous->dirty = true;
+
+		// Baked at the old scale
+		std::unordered_map <long long, std::vector <float>>().swap(previous->frames);
+		std::vector <float>().swap(previous->frameValues);
+
+		m_entries[key] = previous;
+		return previous;
+	}
+
+	CurvatureMeshEntry *entry = new CurvatureMeshEntry(key);
+	m_entries[key] = entry;
+
+	// A shared previous entry stays, but its topology serves this one as well
+	if (NULL != previous && !previous->busy && previous->mesh.hasTopology &&
+		previous->key.node == key.node && previous->key.component == component) {
+		entry->mesh.topology = previous->mesh.topology;
+		entry->mesh.topologyFingerprint = previous->mesh.topologyFingerprint;
+		entry->mesh.hasTopology = true;
+	}
+
+	entry->refs++;
+	return entry;
+}
+
+void CurvatureMeshCache::release(CurvatureMeshEntry *entry) {
+	if (NULL == entry)
+		return;
+
+	{
+		std::lock_guard <std::mutex> lock(m_mutex);
+
+		if (0 != --entry->refs)
+			return;
+
+		m_entries.erase(entry->key);
+	}
+
+	// Let a background update finish with the mesh first
+	entry->waitUpdate();
+
+	delete entry;
+}
+
+size_t CurvatureMeshCache::size() {
+	std::lock_guard <std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
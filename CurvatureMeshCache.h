@@ -0,0 +1,121 @@
+#pragma once
+
+#include <maya\MObject.h>
+#include <maya\MObjectHandle.h>
+#include <maya\MCallbackIdArray.h>
+#include <maya\MTime.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+
+#include "CurvatureCore.h"
+
+// Curvature shared by every instance and every curvatureShader drawing the
+// same faces of a mesh shape at the same effective (scale and shear) world
+// transform with the same kernel, estimator and precision.
+// Shaders keep only their own colors, memory and compute follow unique meshes.
+
+struct CurvatureMeshKey {
+	MObjectHandle node;
+	uint64_t component;		// CurvatureTopology::fingerprint of the drawn faces
+	double scale[4][4];
+	CurvatureKernel kernel;
+	CurvatureEstimator estimator;
+	CurvaturePrecision precision;
+
+	bool operator==(const CurvatureMeshKey &other) const;
+};
+
+struct CurvatureMeshKeyHash {
+	size_t operator()(const CurvatureMeshKey &key) const;
+};
+
+class CurvatureMeshEntry {
+public:
+	CurvatureMeshEntry(const CurvatureMeshKey &key);
+	~CurvatureMeshEntry();
+
+	// Heap memory of the mesh, the buffer copies and the baked frames
+	size_t byteSize() const;
+
+	bool dirty = true;
+	bool vp2 = false;
+
+	// A background update owns the mesh while busy, pending until swapped in
+	std::atomic <bool> busy;
+	bool pending = false;
+	bool succeeded = false;
+
+	// Called by the background update as its last access to the entry
+	void finishUpdate();
+	// Blocks until the background update of this entry, if any, is done
+	void waitUpdate();
+
+	// Queued by a draw for CurvatureShader::runUpdates
+	bool scheduled = false;
+
+	// Bumped by every successful mesh update, colors remember the one they show
+	unsigned long long generation = 0;
+	// Range of mesh.changed computed by the latest generation
+	size_t stepBegin = 0;
+	size_t stepEnd = 0;
+
+	// Dirty callbacks that did and did not invalidate the curvature
+	unsigned long long invalidations = 0;
+	unsigned long long filteredInvalidations = 0;
+
+	// Set until the first complete pass was loaded from or stored to the disk cache
+	bool firstPass = true;
+	unsigned long long diskLoads = 0;
+
+	// Curvature baked by curvatureShaderBake, per mesh vertex ID, keyed by frameKey()
+	std::unordered_map <long long, std::vector <float>> frames;
+	unsigned long long frameHits = 0;
+	unsigned long long frameMisses = 0;
+	// Baked frame expanded to the draw vertices of a draw without vertexIDs
+	std::vector <float> frameValues;
+
+	static long long frameKey(const MTime &time);
+
+	unsigned int refs = 0;
+
+	CurvatureMesh mesh;
+
+	// Copies of the draw buffers read by the background update
+	std::vector <unsigned int> indices;
+	std::vector <float> vertices;
+	std::vector <float> normals;
+	std::vector <int> vertexIDs;
+
+	CurvatureMeshKey key;
+	MCallbackIdArray callbacks;
+
+private:
+	std::mutex m_updateMutex;
+	std::condition_variable m_updateDone;
+};
+
+class CurvatureMeshCache {
+public:
+	static CurvatureMeshCache& instance();
+
+	// Entry for the faces of the shape at the given scale matrix, created on
+	// first use. A new scale of the caller's previous entry, when nothing
+	// else uses that one, moves it to the new key instead: the topology is
+	// kept and previous is returned without another reference. A new entry
+	// for the same faces as previous starts from a copy of its topology.
+	CurvatureMeshEntry* acquire(const MObject &shape, uint64_t component, const double scale[4][4], CurvatureKernel kernel,
+		CurvatureEstimator estimator, CurvaturePrecision precision, CurvatureMeshEntry *previous = NULL);
+	// Deletes the entry with its last reference
+	void release(CurvatureMeshEntry *entry);
+
+	size_t size();
+
+private:
+	CurvatureMeshCache() {}
+
+	std::mutex m_mutex;
+	std::unordered_map <CurvatureMeshKey, CurvatureMeshEntry*, CurvatureMeshKeyHash> m_entries;
+};
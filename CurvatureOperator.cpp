@@ -0,0 +1,148 @@
+#include "CurvatureOperator.h"
+#include "CurvatureCore.h"
+#include "CurvatureThreadPool.h"
+
+#include <cmath>
+
+static const size_t kGrain = 1024;
+static const double kPi = 3.14159265358979323846;
+
+template <class Index>
+void CurvatureOperator::build(int indexCount, const Index *indexArray, const CurvatureTopology &topology, unsigned int threadCount) {
+	unsigned int numVertices = topology.vertexCount();
+	int numTriangles = indexCount / 3;
+
+	// Count the fans, then fill them in triangle order
+	fanOffsets.assign(numVertices + 1, 0);
+	for (int i = 0; i < numTriangles * 3; i += 3) {
+		unsigned int a = topology.unique(indexArray[i]);
+		unsigned int b = topology.unique(indexArray[i + 1]);
+		unsigned int c = topology.unique(indexArray[i + 2]);
+		if (a == b || b == c || c == a)
+			continue;
+		fanOffsets[a + 1]++;
+		fanOffsets[b + 1]++;
+		fanOffsets[c + 1]++;
+	}
+	for (unsigned int v = 0; v < numVertices; v++)
+		fanOffsets[v + 1] += fanOffsets[v];
+
+	std::vector <unsigned int> fill(fanOffsets.begin(), fanOffsets.end() - 1);
+	fans.resize(size_t(fanOffsets[numVertices]) * 2);
+	for (int i = 0; i < numTriangles * 3; i += 3) {
+		unsigned int corners[3] = {
+			topology.unique(indexArray[i]),
+			topology.unique(indexArray[i + 1]),
+			topology.unique(indexArray[i + 2]) };
+		if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+			continue;
+		for (unsigned int t = 0; t < 3; t++) {
+			size_t slot = size_t(fill[corners[t]]++) * 2;
+			fans[slot] = corners[(t + 1) % 3];
+			fans[slot + 1] = corners[(t + 2) % 3];
+		}
+	}
+
+	// Inside a closed fan every neighbour is a corner of two triangles
+	boundary.resize(numVertices);
+	CurvatureThreadPool::instance().parallelFor(numVertices, kGrain, threadCount, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			size_t first = size_t(fanOffsets[v]) * 2, last = size_t(fanOffsets[v + 1]) * 2;
+			bool open = false;
+			for (size_t a = first; !open && a < last; a++) {
+				unsigned int count = 0;
+				for (size_t b = first; b < last; b++)
+					count += fans[a] == fans[b];
+				open = 2 != count;
+			}
+			boundary[v] = open;
+		}
+	});
+}
+
+void CurvatureOperator::clear() {
+	std::vector <unsigned int>().swap(fanOffsets);
+	std::vector <unsigned int>().swap(fans);
+	std::vector <unsigned char>().swap(boundary);
+}
+
+size_t CurvatureOperator::byteSize() const {
+	return (fanOffsets.capacity() + fans.capacity()) * sizeof(unsigned int) + boundary.capacity();
+}
+
+static inline CurvatureVector cross(const CurvatureVector &a, const CurvatureVector &b) {
+	return CurvatureVector(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+// Mixed Voronoi area of corner i: the circumcentric share of a non-obtuse
+// triangle, else half of it when obtuse at i, a quarter when obtuse elsewhere.
+// twiceArea is |a x b|, cotJ and cotK the cotangents opposite edges b and a.
+static inline double mixedArea(const CurvatureVector &a, const CurvatureVector &b, double twiceArea, double cotI, double cotJ, double cotK) {
+	if (cotI < 0)
+		return twiceArea / 4;
+	if (cotJ < 0 || cotK < 0)
+		return twiceArea / 8;
+	return ((a * a) * cotK + (b * b) * cotJ) / 8;
+}
+
+template <class Scalar>
+double CurvatureOperator::mean(unsigned int v, const CurvatureVectorArrayT <Scalar> &vertices, const CurvatureVectorArrayT <Scalar> &normals) const {
+	CurvatureVector vertex = vertices.get(v);
+	CurvatureVector laplacian;
+	double area = 0;
+
+	for (size_t f = size_t(fanOffsets[v]) * 2; f < size_t(fanOffsets[v + 1]) * 2; f += 2) {
+		CurvatureVector a = vertices.get(fans[f]) - vertex;
+		CurvatureVector b = vertices.get(fans[f + 1]) - vertex;
+		CurvatureVector c = b - a;
+
+		double twiceArea = cross(a, b).length();
+		if (!(0 < twiceArea))
+			continue;
+
+		double cotI = (a * b) / twiceArea;
+		double cotJ = -(a * c) / twiceArea;
+		double cotK = (b * c) / twiceArea;
+
+		// Edge to j is opposite k and the other way around
+		laplacian += CurvatureVector(a.x * cotK + b.x * cotJ, a.y * cotK + b.y * cotJ, a.z * cotK + b.z * cotJ);
+		area += mixedArea(a, b, twiceArea, cotI, cotJ, cotK);
+	}
+
+	// The Laplacian is laplacian / 2A and -2 H n
+	if (!(0 < area))
+		return 0;
+	return -(laplacian * normals.get(v)) / (4 * area);
+}
+
+template <class Scalar>
+double CurvatureOperator::gaussian(unsigned int v, const CurvatureVectorArrayT <Scalar> &vertices) const {
+	CurvatureVector vertex = vertices.get(v);
+	double angles = 0;
+	double area = 0;
+
+	for (size_t f = size_t(fanOffsets[v]) * 2; f < size_t(fanOffsets[v + 1]) * 2; f += 2) {
+		CurvatureVector a = vertices.get(fans[f]) - vertex;
+		CurvatureVector b = vertices.get(fans[f + 1]) - vertex;
+		CurvatureVector c = b - a;
+
+		double twiceArea = cross(a, b).length();
+		if (!(0 < twiceArea))
+			continue;
+
+		angles += atan2(twiceArea, a * b);
+		area += mixedArea(a, b, twiceArea, (a * b) / twiceArea, -(a * c) / twiceArea, (b * c) / twiceArea);
+	}
+
+	// A boundary vertex is flat at a half turn
+	if (!(0 < area))
+		return 0;
+	return ((boundary[v] ? kPi : 2 * kPi) - angles) / area;
+}
+
+template void CurvatureOperator::build(int, const unsigned short*, const CurvatureTopology&, unsigned int);
+template void CurvatureOperator::build(int, const unsigned int*, const CurvatureTopology&, unsigned int);
+template double CurvatureOperator::mean(unsigned int, const CurvatureVectorArray&, const CurvatureVectorArray&) const;
+template double CurvatureOperator::mean(unsigned int, const CurvatureVectorArrayF&, const CurvatureVectorArrayF&) const;
+template double CurvatureOperator::gaussian(unsigned int, const CurvatureVectorArray&) const;
+template double CurvatureOperator::gaussian(unsigned int, const CurvatureVectorArrayF&) const;
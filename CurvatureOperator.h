@@ -0,0 +1,39 @@
+#pragma once
+
+// Sparse per-vertex curvature operators: the cotangent Laplacian for mean
+// curvature and the angle deficit for Gaussian curvature, both normalized by
+// the mixed Voronoi area of Meyer et al. Their sparsity, each vertex's fan of
+// incident triangles stored CSR style, depends only on the topology and is
+// built once per topology. The cotangent weights depend on the positions, so
+// a row is evaluated by computing its weights and applying them in the same
+// pass, which touches every vertex of the one-ring once.
+
+#include <cstddef>
+#include <vector>
+
+class CurvatureTopology;
+template <class Scalar> struct CurvatureVectorArrayT;
+
+class CurvatureOperator {
+public:
+	// Triangles are taken from the index buffer through topology.unique().
+	// Triangles with repeated corners are left out.
+	template <class Index>
+	void build(int indexCount, const Index *indexArray, const CurvatureTopology &topology, unsigned int threadCount);
+	void clear();
+
+	bool isBuilt() const { return !fanOffsets.empty(); }
+	size_t byteSize() const;
+
+	// Curvature of unique vertex v. Mean curvature is positive where the
+	// surface bends away from the normal, like a sphere seen from outside.
+	// Scalar is the type of the cached vectors, the sums are in double.
+	template <class Scalar>
+	double mean(unsigned int v, const CurvatureVectorArrayT <Scalar> &vertices, const CurvatureVectorArrayT <Scalar> &normals) const;
+	template <class Scalar>
+	double gaussian(unsigned int v, const CurvatureVectorArrayT <Scalar> &vertices) const;
+
+	std::vector <unsigned int> fanOffsets;	// Incident triangles of each unique vertex
+	std::vector <unsigned int> fans;		// Other two corners of each, in winding order
+	std::vector <unsigned char> boundary;	// Vertices on an edge with a single triangle
+};
@@ -0,0 +1,97 @@
+#include "CurvatureProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void CurvatureTimer::add(double ms) {
+	count++;
+	lastMs = ms;
+	totalMs += ms;
+	maxMs = std::max(maxMs, ms);
+}
+
+CurvatureTrace& CurvatureTrace::instance() {
+	static CurvatureTrace trace;
+	return trace;
+}
+
+void CurvatureTrace::start() {
+	std::lock_guard <std::mutex> lock(m_mutex);
+	m_events.clear();
+	m_startNs = std::chrono::duration_cast <std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	m_recording = true;
+}
+
+void CurvatureTrace::stop() {
+	m_recording = false;
+}
+
+size_t CurvatureTrace::eventCount() {
+	std::lock_guard <std::mutex> lock(m_mutex);
+	return m_events.size();
+}
+
+double CurvatureTrace::now() const {
+	long long ns = std::chrono::duration_cast <std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return (ns - m_startNs) / 1000.0;
+}
+
+void CurvatureTrace::add(const char *name, const char *detail, double beginUs, double durationUs) {
+	// Small per-thread ids read better in the viewer than native ones
+	static std::atomic <unsigned int> s_threads{ 0 };
+	static thread_local unsigned int t_thread = ++s_threads;
+
+	Event event = { name, detail ? detail : "", beginUs, durationUs, t_thread };
+
+	std::lock_guard <std::mutex> lock(m_mutex);
+	if (m_recording)
+		m_events.push_back(event);
+}
+
+// Shape paths only need quotes and backslashes escaped
+static std::string escapeJson(const std::string &text) {
+	std::string escaped;
+	for (char c : text) {
+		if ('"' == c || '\\' == c)
+			escaped += '\\';
+		if (0x20 <= (unsigned char)c)
+			escaped += c;
+	}
+	return escaped;
+}
+
+bool CurvatureTrace::write(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (NULL == file)
+		return false;
+
+	std::lock_guard <std::mutex> lock(m_mutex);
+
+	fprintf(file, "{\"traceEvents\":[");
+	for (size_t i = 0; i < m_events.size(); i++) {
+		const Event &event = m_events[i];
+		fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"curvature\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+			i ? "," : "", event.name, event.beginUs, event.durationUs, event.thread);
+		if (!event.detail.empty())
+			fprintf(file, ",\"args\":{\"shape\":\"%s\"}", escapeJson(event.detail).c_str());
+		fprintf(file, "}");
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	return 0 == fclose(file);
+}
+
+CurvatureScope::CurvatureScope(const char *name, CurvatureTimer &timer, const char *detail)
+	: m_name(name), m_detail(detail), m_timer(timer), m_begin(std::chrono::steady_clock::now()) {}
+
+CurvatureScope::~CurvatureScope() {
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration <double, std::milli>(end - m_begin).count();
+	m_timer.add(ms);
+
+	CurvatureTrace &trace = CurvatureTrace::instance();
+	if (trace.isRecording()) {
+		double endUs = trace.now();
+		trace.add(m_name, m_detail, endUs - ms * 1000.0, ms * 1000.0);
+	}
+}
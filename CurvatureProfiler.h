@@ -0,0 +1,73 @@
+#pragma once
+
+// Low overhead timing of the hot paths. A CurvatureScope adds its duration to
+// a CurvatureTimer, and to the Chrome trace (chrome://tracing, Perfetto) while
+// CurvatureTrace is recording. Outside of a recording a scope costs two clock
+// reads and an atomic load.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct CurvatureTimer {
+	unsigned long long count = 0;
+	double lastMs = 0;
+	double totalMs = 0;
+	double maxMs = 0;
+
+	void add(double ms);
+	void reset() { *this = CurvatureTimer(); }
+};
+
+class CurvatureTrace {
+public:
+	static CurvatureTrace& instance();
+
+	// Starting drops the events of a previous recording
+	void start();
+	void stop();
+	bool isRecording() const { return m_recording.load(std::memory_order_relaxed); }
+
+	// Writes the recorded events as Chrome trace JSON, false if the file can't be written
+	bool write(const char *path);
+	size_t eventCount();
+
+	// Times are microseconds since start()
+	void add(const char *name, const char *detail, double beginUs, double durationUs);
+	double now() const;
+
+private:
+	CurvatureTrace() {}
+
+	struct Event {
+		const char *name;
+		std::string detail;
+		double beginUs;
+		double durationUs;
+		unsigned int thread;
+	};
+
+	std::atomic <bool> m_recording{ false };
+	std::atomic <long long> m_startNs{ 0 };
+	std::mutex m_mutex;
+	std::vector <Event> m_events;
+};
+
+// name must outlive the trace, detail (e.g. a shape path) is copied if recorded
+class CurvatureScope {
+public:
+	CurvatureScope(const char *name, CurvatureTimer &timer, const char *detail = NULL);
+	~CurvatureScope();
+
+	CurvatureScope(const CurvatureScope&) = delete;
+	CurvatureScope& operator=(const CurvatureScope&) = delete;
+
+private:
+	const char *m_name;
+	const char *m_detail;
+	CurvatureTimer &m_timer;
+	std::chrono::steady_clock::time_point m_begin;
+};
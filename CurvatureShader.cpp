@@ -1,21 +1,120 @@
 #include "CurvatureShader.h"
 
+#include <maya\MAnimControl.h>
 #include <maya\MGlobal.h>
-#include <set>
+#include <maya\MItDependencyNodes.h>
+#include <maya\MSelectionList.h>
 #include <maya\MTransformationMatrix.h>
 
+#include "CurvatureDiskCache.h"
+#include "CurvatureThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+
 // Attributes
 MObject			 CurvatureShader::aColorMap;
 MObject			 CurvatureShader::aFlatShading;
+MObject			 CurvatureShader::aEstimator;
+MObject			 CurvatureShader::aFastCurvature;
+MObject			 CurvatureShader::aPrecision;
+MObject			 CurvatureShader::aCompactColors;
 MObject			 CurvatureShader::aScale;
+MObject			 CurvatureShader::aThreadCount;
+MObject			 CurvatureShader::aAsync;
+MObject			 CurvatureShader::aFrameBudget;
 MCallbackIdArray CurvatureShader::callbacks;
+std::atomic <unsigned int> CurvatureShader::finishedUpdates(0);
 const MTypeId	 CurvatureShader::typeId(0x00127883);
 
+// Color of vertices without any curvature yet
+static const float kPlaceholder[3] = { 0.5f, 0.5f, 0.5f };
+
+// Vertices refined between two checks of the frame budget
+static const size_t kRefineChunk = 32768;
+// Budget left to the refinement after prepare, at least the first chunk
+static const double kMinRefineMs = 0.001;
+
+// The first complete pass of an entry is read from the disk cache, or else written to it
+static bool loadFromDisk(CurvatureMeshEntry *entry) {
+	if (!entry->firstPass || !CurvatureDiskCache::instance().load(entry->mesh))
+		return false;
+
+	entry->firstPass = false;
+	entry->diskLoads++;
+	return true;
+}
+
+// cold tells whether the refinement started from unknown curvature
+static void storeToDisk(CurvatureMeshEntry *entry, bool cold) {
+	if (!entry->firstPass || !cold || 0 < entry->mesh.remaining())
+		return;
+
+	entry->firstPass = false;
+	CurvatureDiskCache::instance().storeAsync(entry->mesh);
+}
+
+// Computes the queued vertices, all of them or as many as budgetMs allows,
+// as the next generation of the entry
+static void refineEntry(CurvatureMeshEntry *entry, double budgetMs) {
+	entry->stepBegin = entry->mesh.refined;
+	bool cold = entry->mesh.pendingUnknown;
+
+	if (0 < budgetMs) {
+		MTimer timer;
+		timer.beginTimer();
+		do {
+			entry->mesh.refine(kRefineChunk);
+			timer.endTimer();
+		} while (0 < entry->mesh.remaining() && timer.elapsedTime() * 1000.0 < budgetMs);
+	}
+	else
+		entry->mesh.refine(entry->mesh.remaining());
+
+	entry->stepEnd = entry->mesh.refined;
+	entry->generation++;
+
+	storeToDisk(entry, cold);
+}
+
+// Takes the curvature of the current frame if it was baked, counting hits and
+// misses. Draw vertices without vertexIDs keep their own topology and are
+// matched to the baked mesh vertices through frameIDs.
+template <class Index>
+static bool useBakedFrame(CurvatureMeshEntry *entry, int indexCount, const Index *indexArray, int vertexCount, const int *vertexIDs, const int *frameIDs) {
+	if (entry->frames.empty())
+		return false;
+
+	auto frame = entry->frames.find(CurvatureMeshEntry::frameKey(MAnimControl::currentTime()));
+	bool found = frame != entry->frames.end() && (NULL != vertexIDs || NULL != frameIDs);
+
+	if (found && NULL == vertexIDs) {
+		const std::vector <float> &values = frame->second;
+		entry->frameValues.resize(vertexCount);
+		for (int i = 0; found && i < vertexCount; i++) {
+			found = 0 <= frameIDs[i] && size_t(frameIDs[i]) < values.size();
+			entry->frameValues[i] = found ? values[frameIDs[i]] : 0.0f;
+		}
+	}
+
+	if (!found || (NULL != vertexIDs ?
+		!entry->mesh.assign(indexCount, indexArray, vertexCount, vertexIDs, frame->second.data(), frame->second.size()) :
+		!entry->mesh.assign(indexCount, indexArray, vertexCount, (const int*)NULL, entry->frameValues.data(), entry->frameValues.size()))) {
+		entry->frameMisses++;
+		return false;
+	}
+
+	entry->frameHits++;
+	return true;
+}
+
 CurvatureShader::CurvatureShader(){}
 
 CurvatureShader::~CurvatureShader(){
-	for (auto &ptr : m_data)
+	for (auto &ptr : m_data) {
+		bindEntry(ptr.second, NULL);
 		delete ptr.second;
+	}
 }
 
 void* CurvatureShader::creator(){
@@ -46,6 +145,40 @@ MStatus CurvatureShader::initialize(){
 	CHECK_MSTATUS_AND_RETURN_IT(status);
 	attributeAffects(aFlatShading, outColor);
 
+	// Edge averages the normal curvature of the one-ring edges, Mean and
+	// Gaussian come from the cotangent Laplacian and the angle deficit
+	aEstimator = eAttr.create("estimator", "est", kEstimatorEdge, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	eAttr.addField("Edge", kEstimatorEdge);
+	eAttr.addField("Mean", kEstimatorMean);
+	eAttr.addField("Gaussian", kEstimatorGaussian);
+	status = addAttribute(aEstimator);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	attributeAffects(aEstimator, outColor);
+
+	// Edge curvature from the trig-free closed form, off by default for the acos reference
+	aFastCurvature = nAttr.create("fastCurvature", "fc", MFnNumericData::kBoolean, 0, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	status = addAttribute(aFastCurvature);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	attributeAffects(aFastCurvature, outColor);
+
+	// Float halves the memory streamed per vertex on huge meshes
+	aPrecision = eAttr.create("precision", "pre", kPrecisionDouble, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	eAttr.addField("Double", kPrecisionDouble);
+	eAttr.addField("Float", kPrecisionFloat);
+	status = addAttribute(aPrecision);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	attributeAffects(aPrecision, outColor);
+
+	// 8-bit instead of float colors, a quarter of the memory kept per shader
+	aCompactColors = nAttr.create("compactColors", "cc", MFnNumericData::kBoolean, 0, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	status = addAttribute(aCompactColors);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	attributeAffects(aCompactColors, outColor);
+
 	aScale = nAttr.create("scaleFactor", "sf", MFnNumericData::kDouble, 5.0, &status);
 	CHECK_MSTATUS_AND_RETURN_IT(status);
 	nAttr.setMin(0.0);
@@ -54,6 +187,32 @@ MStatus CurvatureShader::initialize(){
 	CHECK_MSTATUS_AND_RETURN_IT(status);
 	attributeAffects(aScale, outColor);
 
+	// 0 uses all cores, 1 computes serially
+	aThreadCount = nAttr.create("threadCount", "tc", MFnNumericData::kInt, 0, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	nAttr.setMin(0);
+	nAttr.setSoftMax(64);
+	status = addAttribute(aThreadCount);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	attributeAffects(aThreadCount, outColor);
+
+	// Compute in the background and draw the last finished result meanwhile
+	aAsync = nAttr.create("asynchronous", "as", MFnNumericData::kBoolean, 0, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	status = addAttribute(aAsync);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	attributeAffects(aAsync, outColor);
+
+	// Milliseconds of curvature per draw, 0 computes everything at once. An
+	// edit or a new mesh is prepared in full first, which may exceed it.
+	aFrameBudget = nAttr.create("frameBudget", "fb", MFnNumericData::kDouble, 0.0, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	nAttr.setMin(0.0);
+	nAttr.setSoftMax(100.0);
+	status = addAttribute(aFrameBudget);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+	attributeAffects(aFrameBudget, outColor);
+
 	return status;
 }
 
@@ -62,12 +221,12 @@ MStatus CurvatureShader::glBind(const MDagPath &shapePath) {
 	if (!shapePath.hasFn(MFn::kMesh))
 		return MStatus::kFailure;
 	
-	CurvatureShaderData* data = getDataPtr(const_cast<MDagPath&>(shapePath));
+	CurvatureShaderData* data = getDataPtr(shapePath);
 
-	if (NULL == data) {
-		std::string path = shapePath.fullPathName().asChar();
-		m_data[path] = new CurvatureShaderData(const_cast<MDagPath&>(shapePath));
-	}
+	if (NULL == data)
+		m_data[shapeKey(shapePath)] = new CurvatureShaderData(shapePath);
+	else
+		data->setPath(shapePath);
 
 	return MS::kSuccess;
 }
@@ -98,22 +257,23 @@ MStatus CurvatureShader::glGeometry(const MDagPath &shapePath,
 	CHECK_MSTATUS(status);
 	pOutColor.asMObject();
 
-	CurvatureShaderData* data = getDataPtr(const_cast<MDagPath&>(shapePath));
+	CurvatureShaderData* data = getDataPtr(shapePath);
 
 	if (NULL == data)
 		return MS::kFailure;
 
 	// Update values
-	if (data->vp2 == true) {
-		data->dirtyNode = true;
-		data->vp2 = false;
-	}
+	data->vp2 = false;
 
 	status = updateCurvature(indexCount, indexArray, vertexCount, vertexArray, vertexIDs, normalArrays[0], shapePath.inclusiveMatrix(), data);
 	CHECK_MSTATUS_AND_RETURN_IT(status);
 
-	float *colors = new float[vertexCount*3];
-	data->getColors(vertexIDs, vertexCount, colors);
+	// Color upload and the draw itself
+	MString traceName = data->traceName();
+	CurvatureScope scope("upload", data->uploadTimer, traceName.asChar());
+
+	bool compact;
+	const void *colors = drawColors(data, vertexCount, compact);
 
 	// Draw mesh
 	glPushAttrib(GL_ALL_ATTRIB_BITS);
@@ -130,7 +290,7 @@ MStatus CurvatureShader::glGeometry(const MDagPath &shapePath,
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glVertexPointer(3, GL_FLOAT, 0, &vertexArray[0]);
 	glEnableClientState(GL_COLOR_ARRAY);
-	glColorPointer(3, GL_FLOAT, 0, colors);
+	glColorPointer(3, compact ? GL_UNSIGNED_BYTE : GL_FLOAT, 0, colors);
 	glEnableClientState(GL_NORMAL_ARRAY);
 	glNormalPointer(GL_FLOAT, 0, &normalArrays[0][0]);
 
@@ -138,144 +298,318 @@ MStatus CurvatureShader::glGeometry(const MDagPath &shapePath,
 
 	glPopClientAttrib();
 	glPopAttrib();
-	
-	delete[] colors;
-	colors = NULL;
 
 	return MS::kSuccess;
 }
 
-MStatus CurvatureShader::updateCurvature(int indexCount, const unsigned int *indexArray, int vertexCount, const float *vertexArray, const int *vertexIDs, const float *normalArray, MMatrix &transform, CurvatureShaderData *data) {
+template <class Index>
+MStatus CurvatureShader::updateCurvature(int indexCount, const Index *indexArray, int vertexCount, const float *vertexArray, const int *vertexIDs, const float *normalArray, const MMatrix &transform, CurvatureShaderData *data, bool block, std::vector <CurvatureUpdateJob> *deferred, const int *frameIDs) {
 	MStatus status;
+
+	MString traceName = data->traceName();
+	CurvatureScope scope("updateCurvature", data->updateTimer, traceName.asChar());
 	
-	// Update vertex curvature ///////////////////////////////////////////////////////////////////////
-	if (data->dirtyNode) {
-		data->dirtyNode = false;
-		data->dirtyColor = true;
+	// Find the shared entry //////////////////////////////////////////////////////////////////////
+	// Faces drawn by this shader, shaders on other face sets of the shape get their own entries
+	uint64_t component = CurvatureTopology::fingerprint(indexCount, indexArray, vertexCount, vertexIDs);
+
+	bool rebind = NULL == data->entry || data->entry->key.component != component || data->entry->key.kernel != m_kernel ||
+		data->entry->key.estimator != m_estimator || data->entry->key.precision != m_precision;
+	if (data->dirtyScale || rebind) {
+		data->dirtyScale = false;
 
 		MTransformationMatrix tMatrix(transform);
-		transform = tMatrix.asScaleMatrix();
+		MMatrix scale = tMatrix.asScaleMatrix();
 
-		std::set <std::string> combinations;
-		std::map <unsigned int, MPoint> vertices;
-		std::map <unsigned int, MVector> normals;
-		std::map <unsigned int, bool> dirty;
-		std::map <unsigned int, double> curvature;
-		std::map <unsigned int, unsigned int> valence;
+		if (rebind || 0 != memcmp(data->entry->key.scale, scale.matrix, sizeof(scale.matrix)))
+			bindEntry(data, CurvatureMeshCache::instance().acquire(data->path.node(), component, scale.matrix, m_kernel, m_estimator, m_precision, data->entry));
+	}
 
-		// Map vertex and normal to indices
-		for (int i = 0; i < vertexCount; ++i) {
-			int vtxId = vertexIDs[i];
+	CurvatureMeshEntry *entry = data->entry;
 
-			if (vertices.find(vtxId) == vertices.end()) {
-				const float* vertex = &vertexArray[i * 3];
-				vertices[vtxId] = vertex;
-				vertices[vtxId] *= transform;
+	// Another instance queued it, colors follow once runUpdates is done
+	if (entry->scheduled)
+		return MS::kSuccess;
 
-				const float* normal = &normalArray[i * 3];
-				normals[vtxId] = normal;
+	// Legacy and VP2 draw vertices are ordered differently
+	if (entry->vp2 != data->vp2) {
+		entry->vp2 = data->vp2;
+		entry->dirty = true;
+	}
 
-				curvature[vtxId] = 0;
-				valence[vtxId] = 0;
-			}
-			else {
-				const float* normal = &normalArray[i * 3];
-				normals[vtxId] += normal;
-			}
+	// Batch sessions always block, so do exact frames asked for by the caller
+	bool interactive = !block && MGlobal::kInteractive == MGlobal::mayaState();
+	bool async = m_async && interactive;
+	bool progressive = !m_async && interactive && 0 < m_frameBudget;
+	double budgetMs = m_frameBudget;
+
+	// Swap in a finished background update /////////////////////////////////////////////////////
+	if (entry->busy && !async)
+		entry->waitUpdate();
+
+	if (entry->pending && !entry->busy) {
+		entry->pending = false;
+
+		// The copied draw buffers are only needed by the update
+		std::vector <unsigned int>().swap(entry->indices);
+		std::vector <float>().swap(entry->vertices);
+		std::vector <float>().swap(entry->normals);
+		std::vector <int>().swap(entry->vertexIDs);
+
+		if (entry->succeeded) {
+			entry->stepBegin = 0;
+			entry->stepEnd = entry->mesh.changed.size();
+			entry->generation++;
 		}
+	}
 
-		// Average normal
-		for (auto &normal : normals) {
-			normal.second *= transform;
-			normal.second.normalize();
-
-			int vtxId = normal.first;
-			
-			// Check if vertex changed
-			if (vertices[vtxId] == data->vertices[vtxId] && normals[vtxId] == data->normals[vtxId]) {
-				curvature[vtxId] = data->curvature[vtxId];
-				dirty[vtxId] = false;
+	// Update vertex curvature, once for all instances ////////////////////////////////////////////
+	if (entry->dirty && !entry->busy) {
+		entry->dirty = false;
+
+		entry->mesh.threadCount = m_threadCount;
+
+		// A frame baked by curvatureShaderBake replaces the whole update
+		if (useBakedFrame(entry, indexCount, indexArray, vertexCount, vertexIDs, frameIDs)) {
+			entry->stepBegin = 0;
+			entry->stepEnd = entry->mesh.changed.size();
+			entry->generation++;
+		}
+		else if (async) {
+			// Color the result swapped in above before the mesh goes back to the
+			// pool, or colors would wait for edits to stop
+			if (entry->succeeded) {
+				status = syncColors(data);
+				CHECK_MSTATUS_AND_RETURN_IT(status);
 			}
+
+			// Draw buffers are only valid during this draw
+			entry->indices.assign(indexArray, indexArray + indexCount);
+			entry->vertices.assign(vertexArray, vertexArray + vertexCount * 3);
+			entry->normals.assign(normalArray, normalArray + vertexCount * 3);
+			if (NULL != vertexIDs)
+				entry->vertexIDs.assign(vertexIDs, vertexIDs + vertexCount);
 			else
-				dirty[vtxId] = true;
-		}
+				entry->vertexIDs.clear();
+
+			entry->busy = true;
+			entry->pending = true;
 
-		// Iterate over triangles
-		for (int i = 0; i < indexCount; i += 3) {
-			
-			// Iterate over vertices in a triangle
-			for (unsigned int t = 0; t < 3; t++) {
-				if (vertexCount <= (int)indexArray[i + t])
-					return MS::kSuccess;
-
-				unsigned int idA = vertexIDs[indexArray[i + t]];
-
-				if (!dirty[idA])
-					continue;
-
-				// Iterate over connected edges
-				for (unsigned int v = 1; v <= 2; v++) {
-					unsigned int idB = vertexIDs[indexArray[i + ((t + v) % 3)]];
-
-					char buffer[16];
-					sprintf_s(buffer, "%d;%d", idA, idB);
-					if (combinations.find(buffer) != combinations.end())
-						continue;
-					combinations.insert(buffer);
-
-					// Compute vertex curvature
-					MVector edge(vertices[idB].x - vertices[idA].x, vertices[idB].y - vertices[idA].y, vertices[idB].z - vertices[idA].z);
-					double angle = acos(normals[idA] * edge.normal());
-
-					double c = 0;
-					if (angle != M_PI / 2) {
-						double compAngle = (angle < M_PI / 2) ? angle : (M_PI - angle);
-						c = 1 / (edge.length() / 2 * sin(compAngle) / sin(M_PI / 2 - compAngle));
-						if (angle < M_PI / 2)
-							c *= -1;
-					}
-
-					curvature[idA] += c;
-					valence[idA]++;
+			CurvatureThreadPool::instance().post([entry, indexCount, vertexCount, component]() {
+				CurvatureMesh &mesh = entry->mesh;
+				entry->succeeded = mesh.prepare(indexCount, entry->indices.data(), vertexCount, entry->vertices.data(),
+					entry->vertexIDs.empty() ? NULL : entry->vertexIDs.data(), entry->normals.data(), entry->key.scale, component);
+
+				if (entry->succeeded && !loadFromDisk(entry)) {
+					bool cold = mesh.pendingUnknown;
+					mesh.refine(mesh.remaining());
+					storeToDisk(entry, cold);
 				}
+				entry->finishUpdate();
+
+				// pollUpdates redraws to swap the result in, MGlobal is main thread only
+				finishedUpdates++;
+			});
+		}
+		else if (NULL != deferred && !progressive) {
+			entry->scheduled = true;
+
+			CurvatureUpdateJob job;
+			job.entry = entry;
+			job.indexCount = indexCount;
+			job.indexArray = indexArray;
+			job.shortIndices = sizeof(Index) == sizeof(unsigned short);
+			job.vertexCount = vertexCount;
+			job.vertexArray = vertexArray;
+			job.vertexIDs = vertexIDs;
+			job.normalArray = normalArray;
+			job.component = component;
+			deferred->push_back(job);
+			return MS::kSuccess;
+		}
+		else {
+			// prepare isn't split, the frame budget pays for it in full
+			MTimer timer;
+			timer.beginTimer();
+			bool prepared = entry->mesh.prepare(indexCount, indexArray, vertexCount, vertexArray, vertexIDs, normalArray, entry->key.scale, component);
+			timer.endTimer();
+			budgetMs -= timer.elapsedTime() * 1000.0;
+
+			if (!prepared)
+				return MS::kSuccess;
+			if (loadFromDisk(entry)) {
+				entry->stepBegin = 0;
+				entry->stepEnd = entry->mesh.changed.size();
+				entry->generation++;
 			}
 		}
+	}
 
-		// Calculate average curvatire
-		for (auto &vtxCrv : curvature)
-			if (1 < valence[vtxCrv.first] && dirty[vtxCrv.first])
-				vtxCrv.second /= valence[vtxCrv.first];
+	// Compute the queued vertices, all of them or as many as the budget left
+	// by prepare allows. One chunk runs regardless, so edits that keep
+	// prepare over budget still make progress.
+	if (!entry->busy && 0 < entry->mesh.remaining()) {
+		refineEntry(entry, progressive ? std::max(budgetMs, kMinRefineMs) : 0);
 
-		data->vertices = vertices;
-		data->normals = normals;
-		data->curvature = curvature;
+		// Resume on the next draw
+		if (0 < entry->mesh.remaining())
+			MGlobal::executeCommandOnIdle("refresh");
 	}
 
-	// Update vertex color ////////////////////////////////////////////////////////////////////////
-	if (data->dirtyColor) {
-		data->dirtyColor = false;
+	// Update vertex color, once per shader ///////////////////////////////////////////////////////
+	CurvatureShaderColors *colors = data->colors;
 
-		status = updateColors(data);
-		CHECK_MSTATUS_AND_RETURN_IT(status);
+	// Keep the last finished colors while the mesh is busy, neutral grey if there are none
+	if (entry->busy) {
+		if (colors->size() != (size_t)vertexCount * 3) {
+			colors->assign(vertexCount * 3, kPlaceholder[0], m_compactColors);
+			colors->dirty = true;
+		}
+		return MS::kSuccess;
 	}
 
-	return MS::kSuccess;
+	return syncColors(data);
 }
 
-MStatus CurvatureShader::updateColors(CurvatureShaderData *data){
-	MStatus status;
+template MStatus CurvatureShader::updateCurvature(int, const unsigned short*, int, const float*, const int*, const float*, const MMatrix&, CurvatureShaderData*, bool, std::vector <CurvatureUpdateJob>*, const int*);
+template MStatus CurvatureShader::updateCurvature(int, const unsigned int*, int, const float*, const int*, const float*, const MMatrix&, CurvatureShaderData*, bool, std::vector <CurvatureUpdateJob>*, const int*);
+
+// The synchronous path of updateCurvature, minus the colors
+static bool runUpdate(CurvatureUpdateJob &job) {
+	CurvatureMeshEntry *entry = job.entry;
+	CurvatureMesh &mesh = entry->mesh;
+	bool prepared = job.shortIndices ?
+		mesh.prepare(job.indexCount, (const unsigned short*)job.indexArray, job.vertexCount, job.vertexArray, job.vertexIDs, job.normalArray, entry->key.scale, job.component) :
+		mesh.prepare(job.indexCount, (const unsigned int*)job.indexArray, job.vertexCount, job.vertexArray, job.vertexIDs, job.normalArray, entry->key.scale, job.component);
+	if (!prepared)
+		return false;
+
+	if (loadFromDisk(entry)) {
+		entry->stepBegin = 0;
+		entry->stepEnd = entry->mesh.changed.size();
+		entry->generation++;
+	}
 
-	data->color.clear();
+	if (0 < entry->mesh.remaining())
+		refineEntry(entry, 0);
+	return true;
+}
 
-	MRampAttribute map(thisMObject(), aColorMap, &status);
-	CHECK_MSTATUS_AND_RETURN_IT(status);
+void CurvatureShader::runUpdates(std::vector <CurvatureUpdateJob> &jobs) {
+	std::sort(jobs.begin(), jobs.end(), [](const CurvatureUpdateJob &a, const CurvatureUpdateJob &b) {
+		return a.vertexCount > b.vertexCount;
+	});
+
+	unsigned int threads = 0 == m_threadCount ? CurvatureThreadPool::instance().size() : m_threadCount;
+	size_t total = 0;
+	for (const CurvatureUpdateJob &job : jobs)
+		total += job.vertexCount;
+
+	// A shape with more than a thread's share of the work would leave the
+	// other threads idle once the rest is done, it uses the whole pool alone.
+	// Its topology build and fingerprint stay serial, so only the shapes
+	// that dominate the draw go this way.
+	size_t large = 0;
+	for (; large < jobs.size() && total < size_t(jobs[large].vertexCount) * threads; large++) {
+		total -= jobs[large].vertexCount;
+		jobs[large].succeeded = runUpdate(jobs[large]);
+	}
+
+	// Inside the pool each shape runs serially, and the pool hands the next
+	// one to whichever thread is free
+	CurvatureThreadPool::instance().parallelFor(jobs.size() - large, 1, m_threadCount, [&](size_t begin, size_t end) {
+		for (size_t i = large + begin; i < large + end; i++)
+			jobs[i].succeeded = runUpdate(jobs[i]);
+	});
+
+	for (CurvatureUpdateJob &job : jobs)
+		job.entry->scheduled = false;
+}
+
+MStatus CurvatureShader::syncColors(CurvatureShaderData *data) {
+	CurvatureMeshEntry *entry = data->entry;
+	CurvatureShaderColors *colors = data->colors;
+	if (!colors->dirty && colors->generation == entry->generation)
+		return MS::kSuccess;
+
+	// Recolor only what the last incremental update or refinement step touched,
+	// unless another instance released its vertex list
+	bool changedOnly = !colors->dirty && colors->generation + 1 == entry->generation &&
+		entry->stepEnd <= entry->mesh.changed.size() && colors->size() == entry->mesh.topology.drawCount() * 3;
+
+	colors->dirty = false;
+	colors->generation = entry->generation;
+
+	MStatus status = updateColors(data, changedOnly);
+	entry->mesh.releaseChanged();
+	return status;
+}
+
+const void* CurvatureShader::drawColors(CurvatureShaderData *data, int vertexCount, bool &compact) {
+	compact = m_compactColors;
+	const void *colors = data->getColors(vertexCount, compact);
+	if (NULL != colors)
+		return colors;
+
+	// A failed update or a switched mode, the mesh may still match the draw
+	CurvatureMeshEntry *entry = data->entry;
+	data->colors->dirty = true;
+	if (NULL != entry && !entry->busy && entry->mesh.hasTopology && entry->mesh.topology.drawCount() == (unsigned int)vertexCount &&
+		entry->mesh.curvature.size() + entry->mesh.curvatureF.size() == entry->mesh.topology.vertexCount()) {
+		MStatus status = syncColors(data);
+		CHECK_MSTATUS(status);
+		colors = data->getColors(vertexCount, compact);
+	}
+
+	if (NULL == colors) {
+		data->colors->assign(vertexCount * 3, kPlaceholder[0], compact);
+		data->colors->dirty = true;
+		colors = data->getColors(vertexCount, compact);
+	}
+	return colors;
+}
+
+// Float or byte colors of the mesh entry, the last refinement step only or all of them
+template <class Color>
+static void applyColors(const CurvatureColorMap &colorMap, const CurvatureMeshEntry *entry, double scale, bool changedOnly, std::vector <Color> &color, unsigned int threadCount) {
+	const CurvatureMesh &mesh = entry->mesh;
+
+	if (changedOnly) {
+		colorMap.applyChanged(mesh, entry->stepBegin, entry->stepEnd, scale, color.data(), threadCount);
+		return;
+	}
+
+	color.resize(mesh.topology.drawCount() * 3);
+	colorMap.apply(mesh, scale, color.data(), threadCount);
 
-	for (auto &curvatue : data->curvature){
-		double value = curvatue.second * m_scale + 0.5;
-		map.getColorAtPosition(float(value), data->color[curvatue.first], &status);
+	// Unfinished vertices show their previous curvature, if they have one
+	if (mesh.pendingUnknown)
+		CurvatureColorMap::fillChanged(mesh, mesh.refined, mesh.changed.size(), kPlaceholder, color.data(), threadCount);
+}
+
+MStatus CurvatureShader::updateColors(CurvatureShaderData *data, bool changedOnly){
+	MStatus status;
+
+	if (!m_colorMap.isBaked()) {
+		status = bakeColorMap();
 		CHECK_MSTATUS_AND_RETURN_IT(status);
 	}
 
+	CurvatureShaderColors *colors = data->colors;
+
+	MString traceName = data->traceName();
+	CurvatureScope scope("color", colors->colorTimer, traceName.asChar());
+
+	// Only the storage of the current mode is kept
+	if (m_compactColors) {
+		std::vector <float>().swap(colors->color);
+		applyColors(m_colorMap, data->entry, m_scale, changedOnly, colors->color8, m_threadCount);
+	}
+	else {
+		std::vector <unsigned char>().swap(colors->color8);
+		applyColors(m_colorMap, data->entry, m_scale, changedOnly, colors->color, m_threadCount);
+	}
+
 	return MS::kSuccess;
 }
 
@@ -294,6 +628,27 @@ MStatus CurvatureShader::setDependentsDirty(const MPlug& plug, MPlugArray& plugA
 	if (plug == aFlatShading)
 		m_dirtyShading = true;
 
+	if (plug == aEstimator)
+		m_dirtyEstimator = true;
+
+	if (plug == aFastCurvature)
+		m_dirtyKernel = true;
+
+	if (plug == aPrecision)
+		m_dirtyPrecision = true;
+
+	if (plug == aCompactColors)
+		m_dirtyCompact = true;
+
+	if (plug == aThreadCount)
+		m_dirtyThreads = true;
+
+	if (plug == aAsync)
+		m_dirtyAsync = true;
+
+	if (plug == aFrameBudget)
+		m_dirtyBudget = true;
+
 	return MS::kSuccess;
 }
 
@@ -322,18 +677,89 @@ MStatus CurvatureShader::setColorMap(){
 	return status;
 }
 
+MStatus CurvatureShader::bakeColorMap(){
+	MStatus status(MStatus::kSuccess);
+
+	MRampAttribute map(thisMObject(), aColorMap, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	for (unsigned int i = 0; i < CurvatureColorMap::kSize; i++) {
+		MColor color;
+		map.getColorAtPosition(float(i) / (CurvatureColorMap::kSize - 1), color, &status);
+		CHECK_MSTATUS_AND_RETURN_IT(status);
+
+		m_colorMap.set(i, color.r, color.g, color.b);
+	}
+
+	return status;
+}
+
 void CurvatureShader::dirtyAll() {
-	for (auto &data : m_data)
-		data.second->dirtyColor = true;
+	for (auto &colors : m_colors)
+		colors.second.dirty = true;
 }
 
-CurvatureShaderData* CurvatureShader::getDataPtr(MDagPath& path) {
-	std::string strPath = path.fullPathName().asChar();
+CurvatureShapeKey CurvatureShader::shapeKey(const MDagPath& path) {
+	CurvatureShapeKey key = { MObjectHandle(path.node()), path.instanceNumber() };
+	return key;
+}
 
-	if (m_data.find(strPath) == m_data.end())
+MStatus CurvatureShader::findShaders(const MString &name, std::vector <MObject> &nodes) {
+	if (0 == name.length()) {
+		for (MItDependencyNodes itNodes(MFn::kPluginHwShaderNode); !itNodes.isDone(); itNodes.next()) {
+			MFnDependencyNode fnNode(itNodes.thisNode());
+			if (typeId == fnNode.typeId())
+				nodes.push_back(itNodes.thisNode());
+		}
+		return MS::kSuccess;
+	}
+
+	MSelectionList list;
+	MObject node;
+	if (!list.add(name) || !list.getDependNode(0, node)) {
+		MGlobal::displayError(name + " not found");
+		return MS::kInvalidParameter;
+	}
+
+	MFnDependencyNode fnNode(node);
+	if (typeId != fnNode.typeId()) {
+		MGlobal::displayError(name + " is not a curvatureShader");
+		return MS::kInvalidParameter;
+	}
+
+	nodes.push_back(node);
+	return MS::kSuccess;
+}
+
+CurvatureShaderData* CurvatureShader::getDataPtr(const MDagPath& path) {
+	auto found = m_data.find(shapeKey(path));
+
+	if (found == m_data.end())
 		return NULL;
 
-	return m_data[strPath];
+	return found->second;
+}
+
+void CurvatureShader::bindEntry(CurvatureShaderData *data, CurvatureMeshEntry *entry) {
+	// Moved to a new scale in place, the colors follow the next generation
+	if (NULL != entry && entry == data->entry) {
+		data->colors->dirty = true;
+		return;
+	}
+
+	if (NULL != data->entry) {
+		if (0 == --data->colors->refs)
+			m_colors.erase(data->entry);
+		CurvatureMeshCache::instance().release(data->entry);
+	}
+
+	data->entry = entry;
+	data->colors = NULL;
+
+	if (NULL != entry) {
+		data->colors = &m_colors[entry];
+		data->colors->refs++;
+	}
 }
 
 MStatus CurvatureShader::compute(const MPlug& plug, MDataBlock& datablock){
@@ -347,6 +773,8 @@ MStatus CurvatureShader::compute(const MPlug& plug, MDataBlock& datablock){
 
 	if (m_dirtyMap) {
 		m_dirtyMap = false;
+		status = bakeColorMap();
+		CHECK_MSTATUS(status);
 		dirtyAll();
 	}
 
@@ -355,6 +783,43 @@ MStatus CurvatureShader::compute(const MPlug& plug, MDataBlock& datablock){
 		m_flatShading = datablock.inputValue(aFlatShading).asBool();
 	}
 
+	// Shapes move to the entries of the new kernel, estimator or precision as they are drawn
+	if (m_dirtyEstimator) {
+		m_dirtyEstimator = false;
+		m_estimator = CurvatureEstimator(datablock.inputValue(aEstimator).asShort());
+	}
+
+	if (m_dirtyKernel) {
+		m_dirtyKernel = false;
+		m_kernel = datablock.inputValue(aFastCurvature).asBool() ? curvatureBestKernel() : kKernelScalar;
+	}
+
+	if (m_dirtyPrecision) {
+		m_dirtyPrecision = false;
+		m_precision = CurvaturePrecision(datablock.inputValue(aPrecision).asShort());
+	}
+
+	if (m_dirtyCompact) {
+		m_dirtyCompact = false;
+		m_compactColors = datablock.inputValue(aCompactColors).asBool();
+		dirtyAll();
+	}
+
+	if (m_dirtyThreads) {
+		m_dirtyThreads = false;
+		m_threadCount = (unsigned int)datablock.inputValue(aThreadCount).asInt();
+	}
+
+	if (m_dirtyAsync) {
+		m_dirtyAsync = false;
+		m_async = datablock.inputValue(aAsync).asBool();
+	}
+
+	if (m_dirtyBudget) {
+		m_dirtyBudget = false;
+		m_frameBudget = datablock.inputValue(aFrameBudget).asDouble();
+	}
+
 	datablock.outputValue(outColor).setClean();
 
 	return status;
@@ -380,8 +845,7 @@ void CurvatureShader::preConnection(MPlug &srcPlug, MPlug &destPlug, bool made,
 	MDagPathArray allPaths;
 	fnNode.getAllPaths(allPaths);
 
-	MDagPath path = allPaths[srcPlug.logicalIndex()];
-	std::string strPath = path.fullPathName().asChar();
+	CurvatureShapeKey key = shapeKey(allPaths[srcPlug.logicalIndex()]);
 
 	MItDependencyGraph itGraph(destPlug.node(), MFn::kPluginHwShaderNode, MItDependencyGraph::kUpstream);
 	for (itGraph.reset(); !itGraph.isDone(); itGraph.next()) {
@@ -392,17 +856,73 @@ void CurvatureShader::preConnection(MPlug &srcPlug, MPlug &destPlug, bool made,
 
 		CurvatureShader *shaderPtr = dynamic_cast <CurvatureShader*>(fnShNode.userNode());
 
-		delete shaderPtr->m_data[strPath];
-		shaderPtr->m_data.erase(strPath);
+		auto found = shaderPtr->m_data.find(key);
+		if (found == shaderPtr->m_data.end())
+			continue;
+
+		shaderPtr->bindEntry(found->second, NULL);
+		delete found->second;
+		shaderPtr->m_data.erase(found);
 	}
 }
 
+// Display, selection and shading plugs of a mesh shape that can't change its
+// curvature. Any other plug, including unknown ones, dirties the mesh.
+bool CurvatureShader::isGeometryPlug(const MPlug &plug) {
+	static const char *displayAttributes[] = {
+		"visibility", "lodVisibility", "drawOverride", "template", "ghosting", "hiddenInOutliner",
+		"useOutlinerColor", "outlinerColor", "isHistoricallyInteresting", "selectionChildHighlighting",
+		"displayColors", "displayColorChannel", "displayVertices", "displayEdges", "displayBorders",
+		"displayCenter", "displayTriangles", "displayUVs", "displayNonPlanar", "displayNormal", "normalSize",
+		"backfaceCulling", "vertexBackfaceCulling", "castsShadows", "receiveShadows", "motionBlur",
+		"primaryVisibility", "visibleInReflections", "visibleInRefractions", "renderInfo", "renderLayerInfo"
+	};
+
+	MPlug rootPlug(plug);
+	while (rootPlug.isChild() || rootPlug.isElement())
+		rootPlug = rootPlug.isElement() ? rootPlug.array() : rootPlug.parent();
+
+	MFnAttribute fnAttr(rootPlug.attribute());
+	MString name = fnAttr.name();
+
+	for (const char *attribute : displayAttributes)
+		if (name == attribute)
+			return false;
+
+	return true;
+}
+
 void CurvatureShader::nodeDirty(MObject& node, MPlug& plug, void *clientData) {
-	CurvatureShaderData *data = (CurvatureShaderData*)clientData;
-	data->dirtyNode = true;
+	CurvatureMeshEntry *entry = (CurvatureMeshEntry*)clientData;
+
+	if (!isGeometryPlug(plug)) {
+		entry->filteredInvalidations++;
+		return;
+	}
+
+	entry->invalidations++;
+	entry->dirty = true;
+}
+
+void CurvatureShader::pollUpdates(float elapsedTime, float lastTime, void *clientData) {
+	if (0 < finishedUpdates.exchange(0))
+		MGlobal::executeCommandOnIdle("refresh");
 }
 
 void CurvatureShader::transformDirty(MObject& node, MDagMessage::MatrixModifiedFlags &modified, void *clientData) {
 	CurvatureShaderData *data = (CurvatureShaderData*)clientData;
-	data->dirtyNode = true;
+
+	// Curvature only sees the scale and shear part of the world matrix. The
+	// flags can't tell, a rotation under a non-uniformly scaled parent changes
+	// it too, so the world scale is compared with the entry's.
+	if (NULL != data->entry) {
+		MMatrix scale = MTransformationMatrix(data->path.inclusiveMatrix()).asScaleMatrix();
+		if (0 == memcmp(data->entry->key.scale, scale.matrix, sizeof(scale.matrix))) {
+			data->filteredInvalidations++;
+			return;
+		}
+	}
+
+	data->invalidations++;
+	data->dirtyScale = true;
 }
\ No newline at end of file
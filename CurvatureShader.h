@@ -22,27 +22,100 @@
 #include <maya\MUserData.h>
 #include <maya\MDagPathArray.h>
 #include <maya\MMatrix.h>
+#include <maya\MFnAttribute.h>
+#include <maya\MObjectHandle.h>
 
+#include <atomic>
 #include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "CurvatureColorMap.h"
+#include "CurvatureCore.h"
+#include "CurvatureMeshCache.h"
 
 class CurvatureShader;
 
+// Identifies a shaded shape instance independently of its DAG path name
+struct CurvatureShapeKey {
+	MObjectHandle node;
+	unsigned int instance;
+
+	bool operator==(const CurvatureShapeKey &other) const { return instance == other.instance && node == other.node; }
+};
+
+struct CurvatureShapeKeyHash {
+	size_t operator()(const CurvatureShapeKey &key) const { return size_t(key.node.hashCode()) * 31 + key.instance; }
+};
+
+// One shader's colors for a shared mesh entry, RGB in draw vertex order.
+// Kept as floats, or as bytes with compactColors, the other is left empty.
+struct CurvatureShaderColors {
+	std::vector <float> color;
+	std::vector <unsigned char> color8;
+	unsigned long long generation = 0;
+	bool dirty = true;
+	unsigned int refs = 0;
+
+	CurvatureTimer colorTimer;
+
+	size_t size() const { return color.size() + color8.size(); }
+	size_t byteSize() const { return color.capacity() * sizeof(float) + color8.capacity(); }
+	// Fills size channels with value, dropping the other storage
+	void assign(size_t size, float value, bool compact);
+};
+
+// A synchronous update queued by updateCurvature during a VP2 draw, so
+// runUpdates computes the shapes of the whole draw in parallel. The draw
+// buffers must stay mapped until then. Plain arguments of prepare, so the
+// draw can reuse its job list without allocating.
+struct CurvatureUpdateJob {
+	CurvatureMeshEntry *entry = NULL;
+	int indexCount = 0;
+	const void *indexArray = NULL;
+	bool shortIndices = false;
+	int vertexCount = 0;
+	const float *vertexArray = NULL;
+	const int *vertexIDs = NULL;
+	const float *normalArray = NULL;
+	uint64_t component = 0;
+	bool succeeded = false;
+};
+
 class CurvatureShaderData : public MUserData{
 public:
-	CurvatureShaderData(MDagPath& path);
+	CurvatureShaderData(const MDagPath& path);
 	virtual ~CurvatureShaderData();
-	bool getColors(const int *vertexIDs, int vertexCount, float *colors);
+	// Colors of the draw vertices, bytes when compact is set, else floats.
+	// NULL when that storage doesn't hold one color per draw vertex.
+	const void* getColors(int vertexCount, bool compact);
 
-	bool dirtyNode = true;
-	bool dirtyColor = true;
+	// Shape path for trace events, empty unless a trace is recording
+	MString traceName() const;
+	// Follows the path the shape is drawn with, which changes when a parent
+	// is reparented or instanced while the key stays the same
+	void setPath(const MDagPath &path);
+
+	bool dirtyScale = true;
 	bool vp2 = false;
 
-	std::map <unsigned int, MPoint> vertices;
-	std::map <unsigned int, MVector> normals;
+	// Mesh vertex of each VP2 draw vertex, only used to look up baked frames.
+	// Kept to avoid reallocating per draw.
+	std::vector <int> vertexIDs;
+
+	// Transform callbacks that did and did not invalidate the curvature
+	unsigned long long invalidations = 0;
+	unsigned long long filteredInvalidations = 0;
 
-	std::map <unsigned int, double> curvature;
-	std::map <unsigned int, MColor> color;
+	// Whole updateCurvature calls and color buffer uploads of this instance
+	CurvatureTimer updateTimer;
+	CurvatureTimer uploadTimer;
 
+	// Shared with the other instances and shaders at the same scale
+	CurvatureMeshEntry *entry = NULL;
+	CurvatureShaderColors *colors = NULL;
+
+	MDagPath path;
 	MCallbackIdArray callbacks;
 };
 
@@ -76,43 +149,90 @@ public:
 
 		virtual MStatus setDependentsDirty(const MPlug& plug, MPlugArray& plugArray);
 		virtual MStatus compute(const MPlug& plug, MDataBlock& block);
+		// Index is unsigned short or unsigned int
+		template <class Index>
 		MStatus updateCurvature(int indexCount,
-			const unsigned int *indexArray,
+			const Index *indexArray,
 			int vertexCount,
 			const float *vertexArray,
 			const int *vertexIDs,
 			const float *normalArray,
-			MMatrix &transform,
-			CurvatureShaderData *data
+			const MMatrix &transform,
+			CurvatureShaderData *data,
+			bool block = false,
+			std::vector <CurvatureUpdateJob> *deferred = NULL,
+			const int *frameIDs = NULL
 			);
-		MStatus updateColors(CurvatureShaderData *data);
-
+		// Runs the updates queued in a draw, largest first. A shape with more
+		// than its share of the draw's vertices per thread is computed alone
+		// across the pool, the others in parallel with each other.
+		void runUpdates(std::vector <CurvatureUpdateJob> &jobs);
+		MStatus updateColors(CurvatureShaderData *data, bool changedOnly = false);
+		// Recolors the instance when its entry has a newer generation
+		MStatus syncColors(CurvatureShaderData *data);
+		// Colors to upload, bytes with compactColors, else floats. Colors that
+		// don't fit the draw are recolored from the mesh, or grey without one.
+		const void* drawColors(CurvatureShaderData *data, int vertexCount, bool &compact);
+
+		static bool isGeometryPlug(const MPlug &plug);
 		static void nodeDirty(MObject& node, MPlug& plug, void *clientData);
 		static void transformDirty(MObject& node, MDagMessage::MatrixModifiedFlags &modified, void *clientData);
+		// Timer callback on the main thread, redraws once background updates finish
+		static void pollUpdates(float elapsedTime, float lastTime, void *clientData);
 
 		void	dirtyAll();
 		
 		MStatus setColorMap();
+		MStatus bakeColorMap();
 
 		static void preConnection(MPlug &srcPlug, MPlug &destPlug, bool made, void *clientData);
-		CurvatureShaderData* getDataPtr(MDagPath& path);
+		static CurvatureShapeKey shapeKey(const MDagPath& path);
+		// Every curvatureShader node, or only the named one. A name that isn't one displays an error.
+		static MStatus findShaders(const MString &name, std::vector <MObject> &nodes);
+		CurvatureShaderData* getDataPtr(const MDagPath& path);
+		void bindEntry(CurvatureShaderData *data, CurvatureMeshEntry *entry);
 
 		static const MTypeId typeId;
 
 		static MObject aColorMap;
 		static MObject aFlatShading;
+		static MObject aEstimator;
+		static MObject aFastCurvature;
+		static MObject aPrecision;
+		static MObject aCompactColors;
 		static MObject aScale;
+		static MObject aThreadCount;
+		static MObject aAsync;
+		static MObject aFrameBudget;
 
 		static MCallbackIdArray callbacks;
+		// Background updates finished since the last pollUpdates
+		static std::atomic <unsigned int> finishedUpdates;
 
 		bool m_flatShading;
-		std::map <std::string, CurvatureShaderData*> m_data;
+		std::unordered_map <CurvatureShapeKey, CurvatureShaderData*, CurvatureShapeKeyHash> m_data;
+		std::unordered_map <CurvatureMeshEntry*, CurvatureShaderColors> m_colors;
 
 private:
 
 	double m_scale;
+	CurvatureColorMap m_colorMap;
+	CurvatureEstimator m_estimator = kEstimatorEdge;
+	CurvatureKernel m_kernel = kKernelScalar;
+	CurvaturePrecision m_precision = kPrecisionDouble;
+	bool m_compactColors = false;
+	unsigned int m_threadCount = 0;
+	bool m_async = false;
+	double m_frameBudget = 0.0;
 	bool
 		m_dirtyScale = true,
 		m_dirtyMap = true,
-		m_dirtyShading = true;
+		m_dirtyShading = true,
+		m_dirtyEstimator = true,
+		m_dirtyKernel = true,
+		m_dirtyPrecision = true,
+		m_dirtyCompact = true,
+		m_dirtyThreads = true,
+		m_dirtyAsync = true,
+		m_dirtyBudget = true;
 };
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "CurvatureShaderBakeCmd.h"
+#include "CurvatureThreadPool.h"
+
+#include <maya\MAnimControl.h>
+#include <maya\MDGContext.h>
+#include <maya\MFloatVectorArray.h>
+#include <maya\MGlobal.h>
+#include <maya\MIntArray.h>
+#include <maya\MObjectArray.h>
+#include <maya\MPlugArray.h>
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+const char *CurvatureShaderBakeCmd::commandName = "curvatureShaderBake";
+
+static const char *kNodeFlag = "-n";
+static const char *kNodeFlagLong = "-node";
+static const char *kStartFlag = "-st";
+static const char *kStartFlagLong = "-startTime";
+static const char *kEndFlag = "-et";
+static const char *kEndFlagLong = "-endTime";
+static const char *kByFlag = "-b";
+static const char *kByFlagLong = "-by";
+static const char *kClearFlag = "-cl";
+static const char *kClearFlagLong = "-clear";
+
+// Object space geometry of one frame, laid out like a draw: one draw vertex
+// per face-vertex of the drawn faces, merged again by vertexIDs
+struct BakeFrame {
+	long long key = 0;
+	bool valid = false;
+	int meshVertexCount = 0;
+
+	std::vector <float> positions;
+	std::vector <float> normals;
+	std::vector <int> vertexIDs;
+	std::vector <unsigned int> indices;
+	std::vector <float> curvature;
+};
+
+// A shaded shape instance with the faces its shader is assigned to, empty
+// when the assignment can't be told and every face is drawn
+struct BakeTarget {
+	CurvatureMeshEntry *entry;
+	std::vector <unsigned char> faces;
+};
+
+static void assignedFaces(const MDagPath &path, const MObject &shader, std::vector <unsigned char> &faces) {
+	MStatus status;
+	faces.clear();
+
+	MFnMesh fnMesh(path, &status);
+	if (!status)
+		return;
+
+	MObjectArray shadingEngines;
+	MIntArray faceShaders;
+	status = fnMesh.getConnectedShaders(path.instanceNumber(), shadingEngines, faceShaders);
+	if (!status)
+		return;
+
+	int assigned = -1;
+	for (unsigned int i = 0; assigned < 0 && i < shadingEngines.length(); i++) {
+		MPlug surfaceShader = MFnDependencyNode(shadingEngines[i]).findPlug("surfaceShader", true, &status);
+		MPlugArray sources;
+		if (!status || !surfaceShader.connectedTo(sources, true, false))
+			continue;
+		for (unsigned int j = 0; j < sources.length(); j++)
+			if (sources[j].node() == shader)
+				assigned = int(i);
+	}
+	if (assigned < 0)
+		return;
+
+	faces.resize(faceShaders.length());
+	for (unsigned int f = 0; f < faceShaders.length(); f++)
+		faces[f] = assigned == faceShaders[f];
+}
+
+static bool fetchFrame(const MPlug &plug, const MTime &time, const std::vector <unsigned char> &faces, BakeFrame &frame) {
+	MStatus status;
+
+	frame.key = CurvatureMeshEntry::frameKey(time);
+	frame.valid = false;
+
+	MDGContext context(time);
+	MObject meshData;
+	status = plug.getValue(meshData, context);
+	if (!status)
+		return false;
+
+	MFnMesh fnMesh(meshData, &status);
+	if (!status)
+		return false;
+
+	int vertexCount = fnMesh.numVertices();
+	const float *points = fnMesh.getRawPoints(&status);
+	if (!status)
+		return false;
+	frame.meshVertexCount = vertexCount;
+
+	MFloatVectorArray normals;
+	MIntArray faceCounts, faceVertices, normalCounts, normalIds, triangleCounts, triangleVertices;
+	fnMesh.getNormals(normals, MSpace::kObject);
+	fnMesh.getVertices(faceCounts, faceVertices);
+	fnMesh.getNormalIds(normalCounts, normalIds);
+	fnMesh.getTriangles(triangleCounts, triangleVertices);
+	if (faceVertices.length() != normalIds.length() || faceCounts.length() != triangleCounts.length() ||
+		(!faces.empty() && faces.size() != faceCounts.length()))
+		return false;
+
+	frame.positions.clear();
+	frame.normals.clear();
+	frame.vertexIDs.clear();
+	frame.indices.clear();
+
+	unsigned int faceVertex = 0, triangleVertex = 0;
+	for (unsigned int f = 0; f < faceCounts.length(); f++) {
+		unsigned int count = faceCounts[f], corners = triangleCounts[f] * 3;
+
+		if (faces.empty() || faces[f]) {
+			unsigned int first = (unsigned int)frame.vertexIDs.size();
+			for (unsigned int i = faceVertex; i < faceVertex + count; i++) {
+				int v = faceVertices[i];
+				const MFloatVector &normal = normals[normalIds[i]];
+				frame.vertexIDs.push_back(v);
+				frame.positions.insert(frame.positions.end(), points + v * 3, points + v * 3 + 3);
+				frame.normals.push_back(normal.x);
+				frame.normals.push_back(normal.y);
+				frame.normals.push_back(normal.z);
+			}
+
+			// Triangle corners are mesh vertices, each one a face-vertex of the same face
+			for (unsigned int i = triangleVertex; i < triangleVertex + corners; i++) {
+				unsigned int corner = 0;
+				while (corner + 1 < count && faceVertices[faceVertex + corner] != triangleVertices[i])
+					corner++;
+				frame.indices.push_back(first + corner);
+			}
+		}
+
+		faceVertex += count;
+		triangleVertex += corners;
+	}
+
+	frame.valid = true;
+	return true;
+}
+
+MSyntax CurvatureShaderBakeCmd::newSyntax() {
+	MSyntax syntax;
+	syntax.addFlag(kNodeFlag, kNodeFlagLong, MSyntax::kString);
+	syntax.addFlag(kStartFlag, kStartFlagLong, MSyntax::kTime);
+	syntax.addFlag(kEndFlag, kEndFlagLong, MSyntax::kTime);
+	syntax.addFlag(kByFlag, kByFlagLong, MSyntax::kTime);
+	syntax.addFlag(kClearFlag, kClearFlagLong);
+	return syntax;
+}
+
+MStatus CurvatureShaderBakeCmd::doIt(const MArgList &args) {
+	MStatus status;
+
+	MArgDatabase argData(syntax(), args, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	MString name;
+	if (argData.isFlagSet(kNodeFlag))
+		argData.getFlagArgument(kNodeFlag, 0, name);
+
+	std::vector <MObject> nodes;
+	status = CurvatureShader::findShaders(name, nodes);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	// Background updates own their meshes
+	CurvatureThreadPool &pool = CurvatureThreadPool::instance();
+	pool.wait();
+
+	// Shared entries of the drawn shapes, each baked once
+	std::vector <BakeTarget> targets;
+	std::unordered_set <CurvatureMeshEntry*> seen;
+	for (MObject &node : nodes) {
+		MFnDependencyNode fnNode(node);
+		CurvatureShader *shaderPtr = dynamic_cast <CurvatureShader*>(fnNode.userNode());
+		if (NULL == shaderPtr)
+			continue;
+
+		for (auto &data : shaderPtr->m_data) {
+			CurvatureMeshEntry *entry = data.second->entry;
+			if (NULL == entry || !entry->key.node.isAlive() || !seen.insert(entry).second)
+				continue;
+
+			BakeTarget target;
+			target.entry = entry;
+			assignedFaces(data.second->path, node, target.faces);
+			targets.push_back(target);
+		}
+	}
+
+	if (argData.isFlagSet(kClearFlag)) {
+		for (BakeTarget &target : targets) {
+			std::unordered_map <long long, std::vector <float>>().swap(target.entry->frames);
+			std::vector <float>().swap(target.entry->frameValues);
+			target.entry->dirty = true;
+		}
+		return MGlobal::executeCommand("refresh");
+	}
+
+	// Frame range, in the UI unit
+	MTime startTime = MAnimControl::minTime(), endTime = MAnimControl::maxTime(), by(1.0, MTime::uiUnit());
+	if (argData.isFlagSet(kStartFlag))
+		argData.getFlagArgument(kStartFlag, 0, startTime);
+	if (argData.isFlagSet(kEndFlag))
+		argData.getFlagArgument(kEndFlag, 0, endTime);
+	if (argData.isFlagSet(kByFlag))
+		argData.getFlagArgument(kByFlag, 0, by);
+	if (!(0 < by.value())) {
+		displayError("-by must be positive");
+		return MS::kInvalidParameter;
+	}
+
+	std::vector <MTime> times;
+	for (MTime time = startTime; time <= endTime; time += by)
+		times.push_back(time);
+
+	// Each block of consecutive frames gets its own mesh, which only
+	// recomputes what moved since its previous frame. The DG is evaluated
+	// serially, one frame of every block per round, then computed in parallel.
+	unsigned int blocks = (unsigned int)std::min<size_t>(pool.size(), times.size());
+	size_t rounds = blocks ? (times.size() + blocks - 1) / blocks : 0;
+
+	int baked = 0;
+	for (BakeTarget &target : targets) {
+		CurvatureMeshEntry *entry = target.entry;
+		MFnDependencyNode fnShape(entry->key.node.object());
+		MPlug plug = fnShape.findPlug("outMesh", true, &status);
+		if (!status)
+			continue;
+
+		std::vector <CurvatureMesh> meshes(blocks);
+		std::vector <BakeFrame> frames(blocks);
+		for (CurvatureMesh &mesh : meshes) {
+			mesh.threadCount = 1;
+			mesh.kernel = entry->mesh.kernel;
+			mesh.estimator = entry->mesh.estimator;
+			mesh.precision = entry->mesh.precision;
+		}
+
+		for (size_t round = 0; round < rounds; round++) {
+			for (unsigned int b = 0; b < blocks; b++) {
+				size_t index = b * rounds + round;
+				frames[b].valid = index < times.size() && fetchFrame(plug, times[index], target.faces, frames[b]);
+			}
+
+			pool.parallelFor(blocks, 1, 0, [&](size_t begin, size_t end) {
+				for (size_t b = begin; b < end; b++) {
+					BakeFrame &frame = frames[b];
+					CurvatureMesh &mesh = meshes[b];
+					if (!frame.valid)
+						continue;
+
+					frame.valid = mesh.update((int)frame.indices.size(), frame.indices.data(), (int)frame.vertexIDs.size(),
+						frame.positions.data(), frame.vertexIDs.data(), frame.normals.data(), entry->key.scale);
+					if (!frame.valid)
+						continue;
+
+					frame.curvature.assign(frame.meshVertexCount, 0.0f);
+					for (unsigned int v = 0; v < mesh.topology.vertexCount(); v++)
+						frame.curvature[mesh.topology.id(v)] = float(mesh.curvatureAt(v));
+				}
+			});
+
+			for (BakeFrame &frame : frames) {
+				if (!frame.valid)
+					continue;
+				entry->frames[frame.key].swap(frame.curvature);
+				baked++;
+			}
+		}
+
+		entry->dirty = true;
+	}
+
+	setResult(baked);
+	return MGlobal::executeCommand("refresh");
+}
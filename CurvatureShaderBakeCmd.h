@@ -0,0 +1,27 @@
+#pragma once
+#include "CurvatureShader.h"
+
+#include <maya\MPxCommand.h>
+#include <maya\MSyntax.h>
+#include <maya\MArgDatabase.h>
+#include <maya\MArgList.h>
+
+// curvatureShaderBake [-node shader] [-startTime t] [-endTime t] [-by step] [-clear]
+// Computes the curvature of every shape drawn by the shaders for each frame
+// of a range, the playback range by default, and keeps it in memory as one
+// float per mesh vertex. Drawing a baked frame then only recolors, so
+// playback isn't held back by the curvature. Frames are evaluated one after
+// the other and computed in parallel. Shapes must have been drawn once, and
+// a bake goes stale when the animation changes: rebake, or -clear it.
+// Returns the number of frames baked over all shapes.
+class CurvatureShaderBakeCmd : public MPxCommand
+{
+public:
+	static void* creator() { return new CurvatureShaderBakeCmd(); }
+	static MSyntax newSyntax();
+
+	virtual MStatus doIt(const MArgList &args);
+	virtual bool isUndoable() const { return false; }
+
+	static const char *commandName;
+};
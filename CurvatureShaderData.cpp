@@ -1,8 +1,7 @@
 #include "curvatureShader.h"
 #include <maya\MGlobal.h>
 
-CurvatureShaderData::CurvatureShaderData(MDagPath& path) : MUserData(false) {
-	callbacks.append(MNodeMessage::addNodeDirtyPlugCallback(path.node(), CurvatureShader::nodeDirty, this));
+CurvatureShaderData::CurvatureShaderData(const MDagPath& path) : MUserData(false), path(path) {
 	callbacks.append(MDagMessage::addWorldMatrixModifiedCallback(path, CurvatureShader::transformDirty, this));
 }
 
@@ -10,14 +9,39 @@ CurvatureShaderData::~CurvatureShaderData() {
 	MMessage::removeCallbacks(callbacks);
 }
 
-bool CurvatureShaderData::getColors(const int *vertexIDs, int vertexCount, float *colors) {
-	for (int i = 0; i < vertexCount; i++) {
-		unsigned int vtxId = vertexIDs[i];
+void CurvatureShaderData::setPath(const MDagPath &path) {
+	if (path == this->path)
+		return;
 
-		colors[i * 3 + 0] = color[vtxId].r;
-		colors[i * 3 + 1] = color[vtxId].g;
-		colors[i * 3 + 2] = color[vtxId].b;
+	// Reparented or reinstanced, the transform callback follows the new path
+	MMessage::removeCallbacks(callbacks);
+	callbacks.clear();
+	this->path = path;
+	callbacks.append(MDagMessage::addWorldMatrixModifiedCallback(path, CurvatureShader::transformDirty, this));
+	dirtyScale = true;
+}
+
+MString CurvatureShaderData::traceName() const {
+	if (!CurvatureTrace::instance().isRecording())
+		return MString();
+
+	return path.fullPathName();
+}
+
+void CurvatureShaderColors::assign(size_t size, float value, bool compact) {
+	if (compact) {
+		std::vector <float>().swap(color);
+		color8.assign(size, CurvatureColorMap::toByte(value));
 	}
+	else {
+		std::vector <unsigned char>().swap(color8);
+		color.assign(size, value);
+	}
+}
 
-	return true;
+const void* CurvatureShaderData::getColors(int vertexCount, bool compact) {
+	size_t size = (size_t)vertexCount * 3;
+	if (compact)
+		return colors->color8.size() == size ? colors->color8.data() : NULL;
+	return colors->color.size() == size ? colors->color.data() : NULL;
 }
\ No newline at end of file
@@ -4,13 +4,17 @@
 #include <maya\MGlobal.h>
 #include <maya/MGLFunctionTable.h>
 
+#include <cstring>
+
 MString CurvatureShaderOverride::registrantId = "curvatureShaderRegistrantId";
 
 MString CurvatureShaderOverride::initialize(const MInitContext &initContext, MInitFeedback &initFeedback){
-	addIndexingRequirement(MHWRender::MIndexBufferDescriptor(MHWRender::MIndexBufferDescriptor::kTriangle, "indices", MHWRender::MGeometry::kTriangles, 0, MObject::kNullObj, MHWRender::MGeometry::kInt16));
+	addIndexingRequirement(MHWRender::MIndexBufferDescriptor(MHWRender::MIndexBufferDescriptor::kTriangle, "indices", MHWRender::MGeometry::kTriangles, 0, MObject::kNullObj, MHWRender::MGeometry::kUnsignedInt32));
 	addGeometryRequirement(MHWRender::MVertexBufferDescriptor("positions", MHWRender::MGeometry::kPosition, MHWRender::MGeometry::kFloat, 3));
 	addGeometryRequirement(MHWRender::MVertexBufferDescriptor("normals", MHWRender::MGeometry::kNormal, MHWRender::MGeometry::kFloat, 3));
 	addGeometryRequirement(MHWRender::MVertexBufferDescriptor("color", MHWRender::MGeometry::kColor, MHWRender::MGeometry::kFloat, 3));
+	// Mesh vertex of each draw vertex, to look up frames baked per mesh vertex
+	addGeometryRequirement(MHWRender::MVertexBufferDescriptor("vertexid", MHWRender::MGeometry::kTexture, "vertexid", MHWRender::MGeometry::kFloat, 1));
 
 	MInitContext* context = const_cast<MInitContext*>(&initContext);
 
@@ -18,16 +22,43 @@ MString CurvatureShaderOverride::initialize(const MInitContext &initContext, MIn
 
 	MDagPath nodePath = context->dagPath;
 
-	std::string path = nodePath.fullPathName().asChar();
-
 	CurvatureShaderData *data = fShaderNode->getDataPtr(nodePath);
 	if (NULL==data)
-		fShaderNode->m_data[path] = new CurvatureShaderData(nodePath);
+		fShaderNode->m_data[CurvatureShader::shapeKey(nodePath)] = new CurvatureShaderData(nodePath);
+	else
+		data->setPath(nodePath);
 
 	return "Autodesk Maya curvatureShader";
 }
 
 
+// Vertex IDs of the draw vertices, converted into data->vertexIDs. NULL
+// when Maya doesn't provide them or floats can't hold them exactly, which
+// only makes baked frames miss: the curvature itself is computed on the
+// draw vertices as they are.
+static const int* mapVertexIDs(const MHWRender::MGeometry *geometry, CurvatureShaderData *data, unsigned int numVertices) {
+	static const float kExactFloat = 16777216.0f;
+
+	MHWRender::MVertexBuffer *idBuffer = 3 < geometry->vertexBufferCount() ?
+		const_cast<MHWRender::MVertexBuffer*>(geometry->vertexBuffer(3)) : NULL;
+	if (NULL == idBuffer || idBuffer->vertexCount() != numVertices)
+		return NULL;
+
+	const float *ids = (const float*)idBuffer->map();
+	if (NULL == ids)
+		return NULL;
+
+	bool exact = true;
+	data->vertexIDs.resize(numVertices);
+	for (unsigned int i = 0; exact && i < numVertices; i++) {
+		exact = 0 <= ids[i] && ids[i] < kExactFloat;
+		data->vertexIDs[i] = int(ids[i]);
+	}
+	idBuffer->unmap();
+
+	return exact ? data->vertexIDs.data() : NULL;
+}
+
 bool CurvatureShaderOverride::draw(MHWRender::MDrawContext& context, const MHWRender::MRenderItemList& renderItemList) const {
 	MStatus status;
 
@@ -36,8 +67,19 @@ bool CurvatureShaderOverride::draw(MHWRender::MDrawContext& context, const MHWRe
 	MPlug pOutColor = fnNode.findPlug(CurvatureShader::outColor, &status);
 	CHECK_MSTATUS(status);
 	pOutColor.asMObject();
+
+	// Playblasts and renders to image wait for exact results
+	MString destination;
+	bool block = MHWRender::MFrameContext::kImage == context.renderingDestination(destination);
 	
-	// Update values
+	// Map every item, queueing the synchronous updates //////////////////////////////////////////
+	std::vector <DrawItem> &items = fItems;
+	std::vector <CurvatureUpdateJob> &jobs = fJobs;
+	items.clear();
+	jobs.clear();
+
+	MMatrix world = context.getMatrix(MHWRender::MFrameContext::kWorldMtx);
+
 	for (int renderItemIdx = 0; renderItemIdx < renderItemList.length(); renderItemIdx++)
 	{
 		const MHWRender::MRenderItem* renderItem = renderItemList.itemAt(renderItemIdx);
@@ -46,47 +88,84 @@ bool CurvatureShaderOverride::draw(MHWRender::MDrawContext& context, const MHWRe
 		CurvatureShaderData* data = fShaderNode->getDataPtr(renderItem->sourceDagPath());
 		if (NULL == data || !renderItem->sourceDagPath().hasFn(MFn::kMesh))
 			continue;
-		
-		// Create index list (just for compatibility with legacy viewport)
-		MHWRender::MVertexBuffer *clrBuffer = const_cast<MHWRender::MVertexBuffer*>(geometry->vertexBuffer(2));
-		unsigned int numVertices = clrBuffer->vertexCount();
-		int *vertexIDs = new int[numVertices];
-		for (unsigned int i = 0; i < numVertices; i++)
-			vertexIDs[i] = i;
-
-		// Update curvature
-		MHWRender::MIndexBuffer *idxBuffer = const_cast<MHWRender::MIndexBuffer*>(geometry->indexBuffer(0));
-		MHWRender::MVertexBuffer *vtxBuffer = const_cast<MHWRender::MVertexBuffer*>(geometry->vertexBuffer(0));
-		MHWRender::MVertexBuffer *nrmBuffer = const_cast<MHWRender::MVertexBuffer*>(geometry->vertexBuffer(1));
-
-		unsigned int *indices = (unsigned int*)idxBuffer->map();
-		float *vertexArray = (float*)vtxBuffer->map();
-		float *normalArray = (float*)nrmBuffer->map();
-
-		if (data->vp2 == false) {
-			data->dirtyNode = true;
-			data->vp2 = true;
+
+		data->setPath(renderItem->sourceDagPath());
+
+		DrawItem item;
+		item.data = data;
+		item.clrBuffer = const_cast<MHWRender::MVertexBuffer*>(geometry->vertexBuffer(2));
+		item.numVertices = item.clrBuffer->vertexCount();
+
+		item.idxBuffer = const_cast<MHWRender::MIndexBuffer*>(geometry->indexBuffer(0));
+		item.vtxBuffer = const_cast<MHWRender::MVertexBuffer*>(geometry->vertexBuffer(0));
+		item.nrmBuffer = const_cast<MHWRender::MVertexBuffer*>(geometry->vertexBuffer(1));
+
+		item.indices = item.idxBuffer->map();
+		item.vertexArray = (float*)item.vtxBuffer->map();
+		item.normalArray = (float*)item.nrmBuffer->map();
+		item.vertexIDs = mapVertexIDs(geometry, data, item.numVertices);
+
+		// 32-bit as required, 16-bit should Maya still hand one out
+		MHWRender::MGeometry::DataType indexType = item.idxBuffer->dataType();
+		item.shortIndices = MHWRender::MGeometry::kUnsignedInt16 == indexType || MHWRender::MGeometry::kInt16 == indexType;
+
+		data->vp2 = true;
+
+		if (item.shortIndices)
+			status = fShaderNode->updateCurvature(item.idxBuffer->size(), (const unsigned short*)item.indices, item.numVertices, item.vertexArray, NULL, item.normalArray, world, data, block, &jobs, item.vertexIDs);
+		else
+			status = fShaderNode->updateCurvature(item.idxBuffer->size(), (const unsigned int*)item.indices, item.numVertices, item.vertexArray, NULL, item.normalArray, world, data, block, &jobs, item.vertexIDs);
+		item.failed = !status;
+		item.deferred = NULL != data->entry && data->entry->scheduled;
+		CHECK_MSTATUS(status);
+
+		items.push_back(item);
+	}
+
+	// Compute the queued shapes together ///////////////////////////////////////////////////////
+	fShaderNode->runUpdates(jobs);
+
+	// A failed update skips the colors of every item on its entry
+	for (const CurvatureUpdateJob &job : jobs) {
+		if (job.succeeded)
+			continue;
+		for (DrawItem &item : items)
+			if (item.data->entry == job.entry)
+				item.failed = true;
+	}
+
+	// Color and upload every item ////////////////////////////////////////////////////////////////
+	for (DrawItem &item : items) {
+		CurvatureShaderData *data = item.data;
+
+		// Shapes updated by runUpdates, a failed one still shows its previous mesh
+		if (item.deferred && !item.failed) {
+			status = fShaderNode->syncColors(data);
+			CHECK_MSTATUS(status);
 		}
 
-		status = fShaderNode->updateCurvature(
-			idxBuffer->size(),
-			indices,
-			numVertices,
-			vertexArray,
-			vertexIDs,
-			normalArray,
-			context.getMatrix(MHWRender::MFrameContext::kWorldMtx),
-			data);
-		CHECK_MSTATUS_AND_RETURN_IT(status);
-
-		idxBuffer->unmap();
-		vtxBuffer->unmap();
-		nrmBuffer->unmap();
-
-		// Update vtx colors
-		float *colors = (float*)clrBuffer->acquire(numVertices, true);
-		data->getColors(vertexIDs, numVertices, colors);
-		clrBuffer->commit(colors);
+		item.idxBuffer->unmap();
+		item.vtxBuffer->unmap();
+		item.nrmBuffer->unmap();
+
+		// Update vtx colors, already in draw order
+		MString traceName = data->traceName();
+		CurvatureScope scope("upload", data->uploadTimer, traceName.asChar());
+
+		bool compact;
+		const void *source = fShaderNode->drawColors(data, item.numVertices, compact);
+		size_t channels = size_t(item.numVertices) * 3;
+
+		// The buffer stays float, compact colors are expanded on the way
+		float *colors = (float*)item.clrBuffer->acquire(item.numVertices, true);
+		if (compact) {
+			const unsigned char *bytes = (const unsigned char*)source;
+			for (size_t i = 0; i < channels; i++)
+				colors[i] = bytes[i] * (1.0f / 255);
+		}
+		else
+			memcpy(colors, source, channels * sizeof(float));
+		item.clrBuffer->commit(colors);
 	}
 
 	// Draw ///////////////////////////////////////////////////////////////////////////////////////
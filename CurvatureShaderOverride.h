@@ -10,6 +10,8 @@
 #include <maya\MGLdefinitions.h>
 #include <maya\MHWGeometryUtilities.h>
 
+#include <vector>
+
 class CurvatureShaderOverride : public MHWRender::MPxShaderOverride
 {
 public:
@@ -30,5 +32,24 @@ public:
 protected:
 	CurvatureShaderOverride(const MObject& obj):MHWRender::MPxShaderOverride(obj), fShaderNode(NULL){}
 
+	// A render item mapped for the duration of a draw
+	struct DrawItem {
+		CurvatureShaderData *data;
+		MHWRender::MIndexBuffer *idxBuffer;
+		MHWRender::MVertexBuffer *vtxBuffer, *nrmBuffer, *clrBuffer;
+		void *indices;
+		float *vertexArray, *normalArray;
+		const int *vertexIDs;
+		unsigned int numVertices;
+		bool shortIndices;
+		bool failed;
+		// Its entry was queued for runUpdates, colors follow afterwards
+		bool deferred;
+	};
+
 	CurvatureShader *fShaderNode;
+
+	// Cleared by every draw, kept so steady draws don't allocate
+	mutable std::vector <DrawItem> fItems;
+	mutable std::vector <CurvatureUpdateJob> fJobs;
 };
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "CurvatureShaderStatsCmd.h"
+
+#include <maya\MGlobal.h>
+#include <maya\MStringArray.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+const char *CurvatureShaderStatsCmd::commandName = "curvatureShaderStats";
+
+static const char *kNodeFlag = "-n";
+static const char *kNodeFlagLong = "-node";
+static const char *kResetFlag = "-r";
+static const char *kResetFlagLong = "-reset";
+static const char *kTraceStartFlag = "-ts";
+static const char *kTraceStartFlagLong = "-traceStart";
+static const char *kTraceWriteFlag = "-tw";
+static const char *kTraceWriteFlagLong = "-traceWrite";
+
+static std::string timerStats(const char *name, const CurvatureTimer &timer) {
+	char text[128];
+	snprintf(text, sizeof(text), " %s=%llu %sMs=%.3f", name, timer.count, name, timer.totalMs);
+	return text;
+}
+
+MSyntax CurvatureShaderStatsCmd::newSyntax() {
+	MSyntax syntax;
+	syntax.addFlag(kNodeFlag, kNodeFlagLong, MSyntax::kString);
+	syntax.addFlag(kResetFlag, kResetFlagLong);
+	syntax.addFlag(kTraceStartFlag, kTraceStartFlagLong);
+	syntax.addFlag(kTraceWriteFlag, kTraceWriteFlagLong, MSyntax::kString);
+	return syntax;
+}
+
+MStatus CurvatureShaderStatsCmd::doIt(const MArgList &args) {
+	MStatus status;
+
+	MArgDatabase argData(syntax(), args, &status);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	// Trace recording
+	CurvatureTrace &trace = CurvatureTrace::instance();
+	if (argData.isFlagSet(kTraceWriteFlag)) {
+		MString path;
+		argData.getFlagArgument(kTraceWriteFlag, 0, path);
+
+		trace.stop();
+		if (!trace.write(path.asChar())) {
+			displayError(MString("can't write ") + path);
+			return MS::kFailure;
+		}
+		displayInfo(MString(("wrote " + std::to_string(trace.eventCount()) + " events to ").c_str()) + path);
+	}
+	if (argData.isFlagSet(kTraceStartFlag))
+		trace.start();
+
+	bool reset = argData.isFlagSet(kResetFlag);
+
+	// Collect shader nodes
+	MString name;
+	if (argData.isFlagSet(kNodeFlag))
+		argData.getFlagArgument(kNodeFlag, 0, name);
+
+	std::vector <MObject> nodes;
+	status = CurvatureShader::findShaders(name, nodes);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	// One line per shape
+	MStringArray result;
+	for (MObject &node : nodes) {
+		MFnDependencyNode fnNode(node);
+		CurvatureShader *shaderPtr = dynamic_cast <CurvatureShader*>(fnNode.userNode());
+		if (NULL == shaderPtr)
+			continue;
+
+		for (auto &entry : shaderPtr->m_data) {
+			CurvatureShaderData *data = entry.second;
+
+			if (reset) {
+				data->invalidations = data->filteredInvalidations = 0;
+				data->updateTimer.reset();
+				data->uploadTimer.reset();
+				if (NULL != data->colors)
+					data->colors->colorTimer.reset();
+				if (NULL != data->entry && !data->entry->busy) {
+					data->entry->invalidations = data->entry->filteredInvalidations = 0;
+					data->entry->frameHits = data->entry->frameMisses = 0;
+					data->entry->mesh.topologyTimer.reset();
+					data->entry->mesh.prepareTimer.reset();
+					data->entry->mesh.curvatureTimer.reset();
+				}
+				continue;
+			}
+
+			std::string line = std::string(fnNode.name().asChar()) + " " + data->path.fullPathName().asChar();
+			unsigned long long invalidations = data->invalidations;
+			unsigned long long filteredInvalidations = data->filteredInvalidations;
+			unsigned int vertices = 0, shared = 0;
+			size_t queued = 0, bytes = 0;
+			unsigned long long diskLoads = 0, frameHits = 0, frameMisses = 0;
+			size_t frames = 0;
+			std::string timers;
+			bool pending = false;
+
+			// Geometry invalidations are counted once per shared entry
+			if (NULL != data->entry) {
+				invalidations += data->entry->invalidations;
+				filteredInvalidations += data->entry->filteredInvalidations;
+				shared = data->entry->refs;
+
+				// The mesh belongs to the background update while busy
+				pending = data->entry->busy;
+				if (!pending) {
+					const CurvatureMesh &mesh = data->entry->mesh;
+					vertices = mesh.topology.vertexCount();
+					queued = mesh.remaining();
+					bytes = data->entry->byteSize();
+					diskLoads = data->entry->diskLoads;
+					frames = data->entry->frames.size();
+					frameHits = data->entry->frameHits;
+					frameMisses = data->entry->frameMisses;
+					timers = timerStats("topology", mesh.topologyTimer) + timerStats("prepare", mesh.prepareTimer) + timerStats("curvature", mesh.curvatureTimer);
+				}
+			}
+			if (NULL != data->colors) {
+				bytes += data->colors->byteSize();
+				timers += timerStats("color", data->colors->colorTimer);
+			}
+
+			line += " vertices=" + std::to_string(vertices);
+			line += " invalidations=" + std::to_string(invalidations);
+			line += " filteredInvalidations=" + std::to_string(filteredInvalidations);
+			line += " shared=" + std::to_string(shared);
+			line += " pending=" + std::to_string(pending);
+			line += " queued=" + std::to_string(queued);
+			line += " bytes=" + std::to_string(bytes);
+			line += " diskLoads=" + std::to_string(diskLoads);
+			line += " frames=" + std::to_string(frames);
+			line += " frameHits=" + std::to_string(frameHits);
+			line += " frameMisses=" + std::to_string(frameMisses);
+			line += timerStats("update", data->updateTimer);
+			line += timers;
+			line += timerStats("upload", data->uploadTimer);
+
+			result.append(line.c_str());
+		}
+	}
+
+	if (!reset)
+		setResult(result);
+
+	return MS::kSuccess;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "CurvatureShader.h"
+
+#include <maya\MPxCommand.h>
+#include <maya\MSyntax.h>
+#include <maya\MArgDatabase.h>
+#include <maya\MArgList.h>
+
+// curvatureShaderStats [-node shader] [-reset] [-traceStart] [-traceWrite file]
+// Returns one string per shaded shape: "shader shapePath key=value ...".
+// Without -node every curvatureShader in the scene is reported. Times are
+// totals in milliseconds since the last -reset. -traceStart records every
+// timed scope until -traceWrite saves them as Chrome trace JSON.
+class CurvatureShaderStatsCmd : public MPxCommand
+{
+public:
+	static void* creator() { return new CurvatureShaderStatsCmd(); }
+	static MSyntax newSyntax();
+
+	virtual MStatus doIt(const MArgList &args);
+	virtual bool isUndoable() const { return false; }
+
+	static const char *commandName;
+};
@@ -0,0 +1,13 @@
+#include "CurvatureShaderWaitCmd.h"
+#include "CurvatureThreadPool.h"
+
+#include <maya\MGlobal.h>
+
+const char *CurvatureShaderWaitCmd::commandName = "curvatureShaderWait";
+
+MStatus CurvatureShaderWaitCmd::doIt(const MArgList &args) {
+	CurvatureThreadPool::instance().wait();
+
+	// Finished results are swapped in by the draw
+	return MGlobal::executeCommand("refresh -force");
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <maya\MPxCommand.h>
+#include <maya\MArgList.h>
+
+// curvatureShaderWait
+// Blocks until every background curvature update has finished and redraws,
+// so the next frame shows exact results. Meant for scripted playblasts of
+// shaders in asynchronous mode.
+class CurvatureShaderWaitCmd : public MPxCommand
+{
+public:
+	static void* creator() { return new CurvatureShaderWaitCmd(); }
+
+	virtual MStatus doIt(const MArgList &args);
+	virtual bool isUndoable() const { return false; }
+
+	static const char *commandName;
+};
@@ -0,0 +1,137 @@
+#include "CurvatureSimd.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CURVATURE_X86
+#endif
+
+#if defined(CURVATURE_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static const double kHalfPi = 1.57079632679489661923;
+static const double kPi = 3.14159265358979323846;
+
+template <class Scalar>
+static void edgesScalar(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreamsT <Scalar> &streams, Scalar *values) {
+	const Scalar halfPi = Scalar(kHalfPi), pi = Scalar(kPi);
+
+	for (size_t i = 0; i < count; i++) {
+		unsigned int idA = from[i], idB = to[i];
+
+		Scalar ex = streams.px[idB] - streams.px[idA];
+		Scalar ey = streams.py[idB] - streams.py[idA];
+		Scalar ez = streams.pz[idB] - streams.pz[idA];
+
+		Scalar length = std::sqrt(ex * ex + ey * ey + ez * ez);
+		Scalar dot = 0;
+		if (0 < length)
+			dot = streams.nx[idA] * (ex / length) + streams.ny[idA] * (ey / length) + streams.nz[idA] * (ez / length);
+		Scalar angle = std::acos(dot);
+
+		Scalar c = 0;
+		if (angle != halfPi) {
+			Scalar compAngle = (angle < halfPi) ? angle : (pi - angle);
+			c = 1 / (length / 2 * std::sin(compAngle) / std::sin(halfPi - compAngle));
+			if (angle < halfPi)
+				c *= -1;
+		}
+
+		values[i] = c;
+	}
+}
+
+void curvatureEdgesScalar(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreams &streams, double *values) {
+	edgesScalar(count, from, to, streams, values);
+}
+
+void curvatureEdgesScalar(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreamsF &streams, float *values) {
+	edgesScalar(count, from, to, streams, values);
+}
+
+template <class Scalar>
+static void edgesFast(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreamsT <Scalar> &streams, Scalar *values) {
+	for (size_t i = 0; i < count; i++) {
+		unsigned int idA = from[i], idB = to[i];
+		values[i] = curvatureEdgeClosedForm(
+			streams.px[idB] - streams.px[idA], streams.py[idB] - streams.py[idA], streams.pz[idB] - streams.pz[idA],
+			streams.nx[idA], streams.ny[idA], streams.nz[idA]);
+	}
+}
+
+void curvatureEdgesFast(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreams &streams, double *values) {
+	edgesFast(count, from, to, streams, values);
+}
+
+void curvatureEdgesFast(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreamsF &streams, float *values) {
+	edgesFast(count, from, to, streams, values);
+}
+
+static bool cpuSupports(CurvatureKernel kernel) {
+#if !defined(CURVATURE_X86)
+	return kKernelScalar == kernel || kKernelFast == kernel;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool sse41 = 0 != (info[2] & (1 << 19));
+	bool osxsave = 0 != (info[2] & (1 << 27));
+	bool avx = 0 != (info[2] & (1 << 28));
+
+	bool avx2 = false;
+	if (osxsave && avx && 6 == (_xgetbv(0) & 6)) {
+		__cpuidex(info, 7, 0);
+		avx2 = 0 != (info[1] & (1 << 5));
+	}
+
+	switch (kernel) {
+	case kKernelSse4: return sse41;
+	case kKernelAvx2: return avx2;
+	default: return true;
+	}
+#else
+	switch (kernel) {
+	case kKernelSse4: return 0 != __builtin_cpu_supports("sse4.1");
+	case kKernelAvx2: return 0 != __builtin_cpu_supports("avx2");
+	default: return true;
+	}
+#endif
+}
+
+CurvatureKernel curvatureBestKernel() {
+	static const CurvatureKernel best =
+		cpuSupports(kKernelAvx2) ? kKernelAvx2 :
+		cpuSupports(kKernelSse4) ? kKernelSse4 :
+		kKernelFast;
+	return best;
+}
+
+bool curvatureKernelSupported(CurvatureKernel kernel) {
+	return cpuSupports(kernel);
+}
+
+template <class Scalar>
+CurvatureEdgeFuncT <Scalar> curvatureEdgeFunc(CurvatureKernel kernel) {
+	if (!cpuSupports(kernel))
+		kernel = curvatureBestKernel();
+
+	switch (kernel) {
+#if defined(CURVATURE_X86)
+	case kKernelSse4: return curvatureEdgesSse4;
+	case kKernelAvx2: return curvatureEdgesAvx2;
+#endif
+	case kKernelFast: return curvatureEdgesFast;
+	default: return curvatureEdgesScalar;
+	}
+}
+
+template CurvatureEdgeFunc curvatureEdgeFunc <double>(CurvatureKernel);
+template CurvatureEdgeFuncF curvatureEdgeFunc <float>(CurvatureKernel);
+
+const char *curvatureKernelName(CurvatureKernel kernel) {
+	switch (kernel) {
+	case kKernelSse4: return "sse4";
+	case kKernelAvx2: return "avx2";
+	case kKernelFast: return "fast";
+	default: return "scalar";
+	}
+}
@@ -0,0 +1,96 @@
+#include "CurvatureSimd.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+// Masked gathers with every lane enabled, the unmasked ones leave their
+// source operand undefined, which GCC warns about with -Wall
+static inline __m256d gather(const double *base, __m128i index) {
+	return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, index, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+}
+
+static inline __m256 gather(const float *base, __m256i index) {
+	return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, index, _mm256_castsi256_ps(_mm256_set1_epi32(-1)), 4);
+}
+
+// Four edges per iteration with gathered positions and normals
+void curvatureEdgesAvx2(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreams &streams, double *values) {
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d minusTwo = _mm256_set1_pd(-2.0);
+	const __m256d perpendicular = _mm256_set1_pd(CurvaturePerpendicular <double>::cosSq);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(from + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(to + i));
+
+		__m256d ex = _mm256_sub_pd(gather(streams.px, b), gather(streams.px, a));
+		__m256d ey = _mm256_sub_pd(gather(streams.py, b), gather(streams.py, a));
+		__m256d ez = _mm256_sub_pd(gather(streams.pz, b), gather(streams.pz, a));
+
+		__m256d nx = gather(streams.nx, a);
+		__m256d ny = gather(streams.ny, a);
+		__m256d nz = gather(streams.nz, a);
+
+		__m256d lengthSq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ex, ex), _mm256_mul_pd(ey, ey)), _mm256_mul_pd(ez, ez));
+		__m256d dot = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(nx, ex), _mm256_mul_pd(ny, ey)), _mm256_mul_pd(nz, ez));
+
+		__m256d denom = _mm256_sqrt_pd(_mm256_mul_pd(lengthSq, _mm256_sub_pd(lengthSq, _mm256_mul_pd(dot, dot))));
+		__m256d c = _mm256_div_pd(_mm256_mul_pd(minusTwo, dot), denom);
+
+		// Zero length and perpendicular edges contribute nothing
+		__m256d keep = _mm256_and_pd(_mm256_cmp_pd(lengthSq, zero, _CMP_GT_OQ),
+			_mm256_cmp_pd(_mm256_mul_pd(dot, dot), _mm256_mul_pd(perpendicular, lengthSq), _CMP_NLT_UQ));
+		c = _mm256_blendv_pd(zero, c, keep);
+		_mm256_storeu_pd(values + i, c);
+	}
+
+	for (; i < count; i++) {
+		unsigned int idA = from[i], idB = to[i];
+		values[i] = curvatureEdgeClosedForm(
+			streams.px[idB] - streams.px[idA], streams.py[idB] - streams.py[idA], streams.pz[idB] - streams.pz[idA],
+			streams.nx[idA], streams.ny[idA], streams.nz[idA]);
+	}
+}
+
+// Eight edges per iteration
+void curvatureEdgesAvx2(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreamsF &streams, float *values) {
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 minusTwo = _mm256_set1_ps(-2.0f);
+	const __m256 perpendicular = _mm256_set1_ps(CurvaturePerpendicular <float>::cosSq);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(from + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(to + i));
+
+		__m256 ex = _mm256_sub_ps(gather(streams.px, b), gather(streams.px, a));
+		__m256 ey = _mm256_sub_ps(gather(streams.py, b), gather(streams.py, a));
+		__m256 ez = _mm256_sub_ps(gather(streams.pz, b), gather(streams.pz, a));
+
+		__m256 nx = gather(streams.nx, a);
+		__m256 ny = gather(streams.ny, a);
+		__m256 nz = gather(streams.nz, a);
+
+		__m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)), _mm256_mul_ps(ez, ez));
+		__m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, ex), _mm256_mul_ps(ny, ey)), _mm256_mul_ps(nz, ez));
+
+		__m256 denom = _mm256_mul_ps(_mm256_sqrt_ps(lengthSq), _mm256_sqrt_ps(_mm256_sub_ps(lengthSq, _mm256_mul_ps(dot, dot))));
+		__m256 c = _mm256_div_ps(_mm256_mul_ps(minusTwo, dot), denom);
+
+		__m256 keep = _mm256_and_ps(_mm256_cmp_ps(lengthSq, zero, _CMP_GT_OQ),
+			_mm256_cmp_ps(_mm256_mul_ps(dot, dot), _mm256_mul_ps(perpendicular, lengthSq), _CMP_NLT_UQ));
+		c = _mm256_blendv_ps(zero, c, keep);
+		_mm256_storeu_ps(values + i, c);
+	}
+
+	for (; i < count; i++) {
+		unsigned int idA = from[i], idB = to[i];
+		values[i] = curvatureEdgeClosedForm(
+			streams.px[idB] - streams.px[idA], streams.py[idB] - streams.py[idA], streams.pz[idB] - streams.pz[idA],
+			streams.nx[idA], streams.ny[idA], streams.nz[idA]);
+	}
+}
+
+#endif
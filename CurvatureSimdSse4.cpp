@@ -0,0 +1,87 @@
+#include "CurvatureSimd.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#include <smmintrin.h>
+
+// Two edges per iteration. SSE has no gather, positions and normals are
+// fetched with scalar loads.
+void curvatureEdgesSse4(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreams &streams, double *values) {
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d minusTwo = _mm_set1_pd(-2.0);
+	const __m128d perpendicular = _mm_set1_pd(CurvaturePerpendicular <double>::cosSq);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		unsigned int a0 = from[i], a1 = from[i + 1];
+		unsigned int b0 = to[i], b1 = to[i + 1];
+
+		__m128d ex = _mm_sub_pd(_mm_set_pd(streams.px[b1], streams.px[b0]), _mm_set_pd(streams.px[a1], streams.px[a0]));
+		__m128d ey = _mm_sub_pd(_mm_set_pd(streams.py[b1], streams.py[b0]), _mm_set_pd(streams.py[a1], streams.py[a0]));
+		__m128d ez = _mm_sub_pd(_mm_set_pd(streams.pz[b1], streams.pz[b0]), _mm_set_pd(streams.pz[a1], streams.pz[a0]));
+
+		__m128d nx = _mm_set_pd(streams.nx[a1], streams.nx[a0]);
+		__m128d ny = _mm_set_pd(streams.ny[a1], streams.ny[a0]);
+		__m128d nz = _mm_set_pd(streams.nz[a1], streams.nz[a0]);
+
+		__m128d lengthSq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ex, ex), _mm_mul_pd(ey, ey)), _mm_mul_pd(ez, ez));
+		__m128d dot = _mm_add_pd(_mm_add_pd(_mm_mul_pd(nx, ex), _mm_mul_pd(ny, ey)), _mm_mul_pd(nz, ez));
+
+		__m128d denom = _mm_sqrt_pd(_mm_mul_pd(lengthSq, _mm_sub_pd(lengthSq, _mm_mul_pd(dot, dot))));
+		__m128d c = _mm_div_pd(_mm_mul_pd(minusTwo, dot), denom);
+
+		// Zero length and perpendicular edges contribute nothing
+		__m128d keep = _mm_and_pd(_mm_cmpgt_pd(lengthSq, zero), _mm_cmpnlt_pd(_mm_mul_pd(dot, dot), _mm_mul_pd(perpendicular, lengthSq)));
+		c = _mm_blendv_pd(zero, c, keep);
+		_mm_storeu_pd(values + i, c);
+	}
+
+	for (; i < count; i++) {
+		unsigned int idA = from[i], idB = to[i];
+		values[i] = curvatureEdgeClosedForm(
+			streams.px[idB] - streams.px[idA], streams.py[idB] - streams.py[idA], streams.pz[idB] - streams.pz[idA],
+			streams.nx[idA], streams.ny[idA], streams.nz[idA]);
+	}
+}
+
+// Four edges per iteration
+void curvatureEdgesSse4(size_t count, const unsigned int *from, const unsigned int *to, const CurvatureEdgeStreamsF &streams, float *values) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 minusTwo = _mm_set1_ps(-2.0f);
+	const __m128 perpendicular = _mm_set1_ps(CurvaturePerpendicular <float>::cosSq);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const unsigned int *a = from + i, *b = to + i;
+
+		__m128 ex = _mm_sub_ps(_mm_set_ps(streams.px[b[3]], streams.px[b[2]], streams.px[b[1]], streams.px[b[0]]),
+			_mm_set_ps(streams.px[a[3]], streams.px[a[2]], streams.px[a[1]], streams.px[a[0]]));
+		__m128 ey = _mm_sub_ps(_mm_set_ps(streams.py[b[3]], streams.py[b[2]], streams.py[b[1]], streams.py[b[0]]),
+			_mm_set_ps(streams.py[a[3]], streams.py[a[2]], streams.py[a[1]], streams.py[a[0]]));
+		__m128 ez = _mm_sub_ps(_mm_set_ps(streams.pz[b[3]], streams.pz[b[2]], streams.pz[b[1]], streams.pz[b[0]]),
+			_mm_set_ps(streams.pz[a[3]], streams.pz[a[2]], streams.pz[a[1]], streams.pz[a[0]]));
+
+		__m128 nx = _mm_set_ps(streams.nx[a[3]], streams.nx[a[2]], streams.nx[a[1]], streams.nx[a[0]]);
+		__m128 ny = _mm_set_ps(streams.ny[a[3]], streams.ny[a[2]], streams.ny[a[1]], streams.ny[a[0]]);
+		__m128 nz = _mm_set_ps(streams.nz[a[3]], streams.nz[a[2]], streams.nz[a[1]], streams.nz[a[0]]);
+
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez));
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, ex), _mm_mul_ps(ny, ey)), _mm_mul_ps(nz, ez));
+
+		__m128 denom = _mm_mul_ps(_mm_sqrt_ps(lengthSq), _mm_sqrt_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(dot, dot))));
+		__m128 c = _mm_div_ps(_mm_mul_ps(minusTwo, dot), denom);
+
+		__m128 keep = _mm_and_ps(_mm_cmpgt_ps(lengthSq, zero), _mm_cmpnlt_ps(_mm_mul_ps(dot, dot), _mm_mul_ps(perpendicular, lengthSq)));
+		c = _mm_blendv_ps(zero, c, keep);
+		_mm_storeu_ps(values + i, c);
+	}
+
+	for (; i < count; i++) {
+		unsigned int idA = from[i], idB = to[i];
+		values[i] = curvatureEdgeClosedForm(
+			streams.px[idB] - streams.px[idA], streams.py[idB] - streams.py[idA], streams.pz[idB] - streams.pz[idA],
+			streams.nx[idA], streams.ny[idA], streams.nz[idA]);
+	}
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include "CurvatureThreadPool.h"
+
+#include <algorithm>
+
+static thread_local bool t_insidePool = false;
+static thread_local bool t_background = false;
+static thread_local unsigned int t_index = 0;
+
+CurvatureThreadPool& CurvatureThreadPool::instance() {
+	static CurvatureThreadPool pool;
+	return pool;
+}
+
+CurvatureThreadPool::CurvatureThreadPool() : m_next(0) {
+	unsigned int cores = std::thread::hardware_concurrency();
+	for (unsigned int i = 1; i < cores; i++)
+		m_workers.emplace_back(&CurvatureThreadPool::workerLoop, this, i);
+}
+
+unsigned int CurvatureThreadPool::threadIndex() {
+	return t_index;
+}
+
+CurvatureThreadPool::~CurvatureThreadPool() {
+	shutdown();
+}
+
+void CurvatureThreadPool::shutdown() {
+	// Tasks may still need the workers
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_queueStop = true;
+	}
+	m_queueWake.notify_all();
+	if (m_background.joinable())
+		m_background.join();
+
+	std::lock_guard<std::mutex> jobLock(m_jobMutex);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	for (auto &worker : m_workers)
+		worker.join();
+	m_workers.clear();
+}
+
+void CurvatureThreadPool::run(size_t count, size_t grain, unsigned int maxThreads, RangeFunc fn, const void *context) {
+	if (0 == count)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+	size_t chunks = (count + grain - 1) / grain;
+	unsigned int threads = (0 == maxThreads) ? size() : std::min(maxThreads, size());
+
+	if (threads <= 1 || chunks <= 1 || t_insidePool) {
+		fn(context, 0, count);
+		return;
+	}
+
+	// Posted tasks wait for the workers. Any other caller, usually a draw,
+	// runs serially instead of stalling behind a long background update.
+	std::unique_lock<std::mutex> jobLock(m_jobMutex, std::defer_lock);
+	if (t_background)
+		jobLock.lock();
+	else if (!jobLock.try_lock()) {
+		fn(context, 0, count);
+		return;
+	}
+
+	if (m_workers.empty()) {
+		fn(context, 0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_fn = fn;
+		m_context = context;
+		m_count = count;
+		m_grain = grain;
+		m_next = 0;
+		m_helpers = (unsigned int)std::min<size_t>(threads - 1, chunks - 1);
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	t_insidePool = true;
+	work();
+	t_insidePool = false;
+
+	// No more helpers may join, wait for the ones still running
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_helpers = 0;
+	m_done.wait(lock, [this] { return 0 == m_active; });
+	m_fn = nullptr;
+	m_context = nullptr;
+}
+
+void CurvatureThreadPool::work() {
+	for (;;) {
+		size_t begin = m_next.fetch_add(m_grain);
+		if (m_count <= begin)
+			break;
+		m_fn(m_context, begin, std::min(begin + m_grain, m_count));
+	}
+}
+
+void CurvatureThreadPool::workerLoop(unsigned int index) {
+	t_insidePool = true;
+	t_index = index;
+
+	unsigned long long seen = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		m_wake.wait(lock, [&] { return m_stop || (seen != m_generation && 0 < m_helpers); });
+		if (m_stop)
+			return;
+
+		seen = m_generation;
+		m_helpers--;
+		m_active++;
+
+		lock.unlock();
+		work();
+		lock.lock();
+
+		if (0 == --m_active)
+			m_done.notify_all();
+	}
+}
+
+void CurvatureThreadPool::post(std::function <void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		if (!m_queueStop) {
+			if (!m_background.joinable())
+				m_background = std::thread(&CurvatureThreadPool::backgroundLoop, this);
+
+			m_queue.push_back(std::move(task));
+			m_queueWake.notify_one();
+			return;
+		}
+	}
+
+	// Shut down, run on the caller
+	task();
+}
+
+void CurvatureThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	m_queueDone.wait(lock, [this] { return m_queue.empty() && !m_taskRunning; });
+}
+
+void CurvatureThreadPool::backgroundLoop() {
+	t_background = true;
+
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	for (;;) {
+		m_queueWake.wait(lock, [this] { return m_queueStop || !m_queue.empty(); });
+
+		// Stopping drains the queue first
+		if (m_queue.empty())
+			return;
+
+		std::function <void()> task = std::move(m_queue.front());
+		m_queue.pop_front();
+		m_taskRunning = true;
+
+		lock.unlock();
+		task();
+		lock.lock();
+
+		m_taskRunning = false;
+		if (m_queue.empty())
+			m_queueDone.notify_all();
+	}
+}
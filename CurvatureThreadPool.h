@@ -0,0 +1,87 @@
+#pragma once
+
+// Process-wide pool of worker threads used by the curvature kernels.
+// parallelFor splits [0, count) into chunks of `grain` items, so every item
+// is processed exactly once and results do not depend on the thread count.
+// post queues whole tasks on one background thread, which may in turn use
+// parallelFor, so long updates don't block the caller.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CurvatureThreadPool {
+public:
+	static CurvatureThreadPool& instance();
+
+	// Worker threads plus the calling thread
+	unsigned int size() const { return (unsigned int)m_workers.size() + 1; }
+	// Index below size() of the calling thread, for per-thread scratch
+	// buffers: 1 and up on the workers, 0 on any other thread
+	static unsigned int threadIndex();
+
+	// maxThreads of 0 uses the whole pool, 1 runs serially on the caller.
+	// Calls made from inside a pool task also run serially, and so do calls
+	// from outside the background thread while the workers are taken. fn is
+	// called as fn(begin, end) and is passed by reference, so nothing is
+	// allocated.
+	template <class Fn>
+	void parallelFor(size_t count, size_t grain, unsigned int maxThreads, const Fn &fn) {
+		run(count, grain, maxThreads, [](const void *context, size_t begin, size_t end) {
+			(*(const Fn*)context)(begin, end);
+		}, &fn);
+	}
+
+	// Runs task on the background thread after the previously posted ones
+	void post(std::function <void()> task);
+	// Blocks until every posted task has finished. Not callable from a task.
+	void wait();
+
+	// Finishes the posted tasks and joins the workers. Must be called before
+	// the plugin is unloaded, the pool runs serially afterwards.
+	void shutdown();
+
+	~CurvatureThreadPool();
+
+private:
+	typedef void (*RangeFunc)(const void *context, size_t begin, size_t end);
+
+	CurvatureThreadPool();
+
+	void run(size_t count, size_t grain, unsigned int maxThreads, RangeFunc fn, const void *context);
+
+	void workerLoop(unsigned int index);
+	void work();
+	void backgroundLoop();
+
+	std::vector <std::thread> m_workers;
+
+	std::mutex m_jobMutex;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	RangeFunc m_fn = nullptr;
+	const void *m_context = nullptr;
+	size_t m_count = 0;
+	size_t m_grain = 1;
+	std::atomic <size_t> m_next;
+
+	unsigned long long m_generation = 0;
+	unsigned int m_helpers = 0;
+	unsigned int m_active = 0;
+	bool m_stop = false;
+
+	std::thread m_background;
+	std::mutex m_queueMutex;
+	std::condition_variable m_queueWake;
+	std::condition_variable m_queueDone;
+	std::deque <std::function <void()>> m_queue;
+	bool m_taskRunning = false;
+	bool m_queueStop = false;
+};
@@ -1,7 +1,14 @@
 #include <maya/MFnPlugin.h>
+#include <maya/MCommonSystemUtils.h>
+#include <maya/MTimerMessage.h>
 
 #include "curvatureShader.h"
+#include "CurvatureDiskCache.h"
+#include "CurvatureShaderBakeCmd.h"
 #include "CurvatureShaderOverride.h"
+#include "CurvatureShaderStatsCmd.h"
+#include "CurvatureShaderWaitCmd.h"
+#include "CurvatureThreadPool.h"
 
 MStatus initializePlugin(MObject obj)
 {
@@ -23,7 +30,25 @@ MStatus initializePlugin(MObject obj)
 		CurvatureShaderOverride::Creator);
 	CHECK_MSTATUS_AND_RETURN_IT(status);
 
+	status = plugin.registerCommand(CurvatureShaderStatsCmd::commandName, CurvatureShaderStatsCmd::creator, CurvatureShaderStatsCmd::newSyntax);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	status = plugin.registerCommand(CurvatureShaderWaitCmd::commandName, CurvatureShaderWaitCmd::creator);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	status = plugin.registerCommand(CurvatureShaderBakeCmd::commandName, CurvatureShaderBakeCmd::creator, CurvatureShaderBakeCmd::newSyntax);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
 	CurvatureShader::callbacks.append(MDGMessage::addConnectionCallback(CurvatureShader::preConnection, NULL, &status));
+	CurvatureShader::callbacks.append(MTimerMessage::addTimerCallback(0.05f, CurvatureShader::pollUpdates, NULL, &status));
+
+	// Optional curvature disk cache, e.g. CURVATURE_SHADER_CACHE=D:/cache/curvature in Maya.env
+	MString cacheDir = MCommonSystemUtils::getEnv("CURVATURE_SHADER_CACHE");
+	if (0 < cacheDir.length()) {
+		MString cacheSize = MCommonSystemUtils::getEnv("CURVATURE_SHADER_CACHE_MB");
+		size_t megabytes = cacheSize.isInt() && 0 < cacheSize.asInt() ? size_t(cacheSize.asInt()) : 2048;
+		CurvatureDiskCache::instance().configure(cacheDir.asChar(), megabytes << 20);
+	}
 
 	return status;
 }
@@ -35,6 +60,18 @@ MStatus uninitializePlugin(MObject obj)
 
 	MMessage::removeCallbacks(CurvatureShader::callbacks);
 
+	// Workers can't be joined from the DLL unload itself
+	CurvatureThreadPool::instance().shutdown();
+
+	status = plugin.deregisterCommand(CurvatureShaderStatsCmd::commandName);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	status = plugin.deregisterCommand(CurvatureShaderWaitCmd::commandName);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
+	status = plugin.deregisterCommand(CurvatureShaderBakeCmd::commandName);
+	CHECK_MSTATUS_AND_RETURN_IT(status);
+
 	status = MHWRender::MDrawRegistry::deregisterShaderOverrideCreator(
 		"drawdb/shader/surface/curvatureShader", CurvatureShaderOverride::registrantId);
 	CHECK_MSTATUS_AND_RETURN_IT(status);